@@ -0,0 +1,93 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "types.h"
+#include "emulator.h"
+#include "memory.h"
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC 0x52563332     /* "RV32" */
+#define CHECKPOINT_VERSION 1
+
+typedef struct {
+    Word magic;
+    Word version;
+    Word processor_size;        /* a layout check: sizeof(Processor) */
+    Word nharts;
+    Word compressed;
+    Word memory_offset;         /* where guest memory starts */
+    Double budget;
+} CheckpointHeader;
+
+static Word memory_offset(int nharts) {
+    size_t size = sizeof(CheckpointHeader) + nharts * sizeof(Processor);
+    return (size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+}
+
+int emulator_save(Emulator *emulator, const char *path, Double budget) {
+    CheckpointHeader header = {CHECKPOINT_MAGIC,
+                               CHECKPOINT_VERSION,
+                               sizeof(Processor),
+                               emulator->nharts,
+                               emulator->compressed,
+                               memory_offset(emulator->nharts),
+                               budget};
+    size_t harts = emulator->nharts * sizeof(Processor);
+    char temporary[4200];
+
+    // written under another name and moved into place once complete
+    snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)getpid());
+    int file = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file < 0) {
+        return -1;
+    }
+    if (pwrite(file, &header, sizeof(header), 0) != sizeof(header) ||
+        pwrite(file, emulator->harts, harts, sizeof(header)) != (ssize_t)harts ||
+        memory_write_image(file, emulator->memory, header.memory_offset) != 0 ||
+        close(file) != 0 || rename(temporary, path) != 0) {
+        unlink(temporary);
+        return -1;
+    }
+    return 0;
+}
+
+Emulator *emulator_open(const char *path, Double *budget) {
+    CheckpointHeader header;
+    Emulator *emulator = NULL;
+    int file = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (file < 0) {
+        return NULL;
+    }
+    if (pread(file, &header, sizeof(header), 0) != sizeof(header) ||
+        header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION ||
+        header.processor_size != sizeof(Processor) || header.nharts < 1 ||
+        header.nharts > EMULATOR_MAX_HARTS ||
+        header.memory_offset != memory_offset(header.nharts)) {
+        goto done;
+    }
+
+    emulator = calloc(1, sizeof(Emulator));
+    if (emulator == NULL) {
+        goto done;
+    }
+    size_t harts = header.nharts * sizeof(Processor);
+    if (pread(file, emulator->harts, harts, sizeof(header)) != (ssize_t)harts ||
+        (emulator->memory = memory_map(file, header.memory_offset)) == NULL) {
+        free(emulator);
+        emulator = NULL;
+        goto done;
+    }
+    emulator->nharts = header.nharts;
+    emulator->compressed = header.compressed;
+    emulator->mapped = 1;
+    emulator->image = -1;
+    *budget = header.budget;
+
+done:
+    // the mapping stays valid once the file is closed
+    close(file);
+    return emulator;
+}
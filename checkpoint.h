@@ -0,0 +1,22 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "types.h"
+#include "emulator.h"
+
+/* A checkpoint file holds a whole machine: a header and the harts, then
+   guest memory from the next page boundary on, with untouched pages left
+   as holes. Opening one maps that memory copy-on-write straight from the
+   file, so a restore reads nothing but the header and the harts. */
+
+/* Saves the machine to path, along with budget for the caller to use as
+   it likes (riscv keeps the instructions the run has left). Returns 0, or
+   -1 on failure. */
+int emulator_save(Emulator *, const char *path, Double budget);
+
+/* Creates a machine from a checkpoint and sets *budget to what was saved
+   with it. Returns NULL if the file cannot be read or is not a checkpoint
+   of this emulator. */
+Emulator *emulator_open(const char *path, Double *budget);
+
+#endif
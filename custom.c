@@ -0,0 +1,261 @@
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "utils.h"
+#include "riscv.h"
+#include "custom.h"
+#include "vector.h"
+
+/* Dispatch table indexed by opcode and funct3. Each slot holds a short chain
+   of the instructions registered for it, in registration order. */
+typedef struct CustomEntry {
+    const CustomInstruction *instruction;
+    struct CustomEntry *next;
+} CustomEntry;
+
+static CustomEntry *custom_table[128][8];
+static pthread_once_t builtins_once = PTHREAD_ONCE_INIT;
+
+static void register_builtins(void);
+
+static int is_custom_opcode(int opcode) {
+    switch (opcode) {
+        case 0x0b:
+        case 0x2a:
+        case 0x2b:
+        case 0x5b:
+        case 0x7b:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Two entries under the same opcode and funct3 conflict when their funct7
+   values overlap, unless both narrow their encodings with match() */
+static int conflicts(const CustomInstruction *a, const CustomInstruction *b) {
+    int overlap = a->funct7 == b->funct7 || a->funct7 == CUSTOM_ANY || b->funct7 == CUSTOM_ANY;
+    return overlap && (a->match == NULL || b->match == NULL);
+}
+
+static int add_custom_instruction(const CustomInstruction *custom) {
+    if (!is_custom_opcode(custom->opcode) || custom->execute == NULL ||
+        custom->funct3 < CUSTOM_ANY || custom->funct3 > 7) {
+        return -1;
+    }
+
+    for (int funct3 = 0; funct3 < 8; funct3++) {
+        if (custom->funct3 != CUSTOM_ANY && custom->funct3 != funct3) {
+            continue;
+        }
+        for (CustomEntry *entry = custom_table[custom->opcode][funct3]; entry != NULL;
+             entry = entry->next) {
+            if (conflicts(entry->instruction, custom)) {
+                return -1;
+            }
+        }
+    }
+
+    for (int funct3 = 0; funct3 < 8; funct3++) {
+        if (custom->funct3 != CUSTOM_ANY && custom->funct3 != funct3) {
+            continue;
+        }
+        CustomEntry *entry = malloc(sizeof(CustomEntry));
+        CustomEntry **tail = &custom_table[custom->opcode][funct3];
+        if (entry == NULL) {
+            return -1;
+        }
+        while (*tail != NULL) {
+            tail = &(*tail)->next;
+        }
+        entry->instruction = custom;
+        entry->next = NULL;
+        *tail = entry;
+    }
+    return 0;
+}
+
+int register_custom_instruction(const CustomInstruction *custom) {
+    pthread_once(&builtins_once, register_builtins);
+    return add_custom_instruction(custom);
+}
+
+const CustomInstruction *find_custom_instruction(Instruction instruction) {
+    pthread_once(&builtins_once, register_builtins);
+    for (CustomEntry *entry = custom_table[instruction.opcode][instruction.rtype.funct3];
+         entry != NULL; entry = entry->next) {
+        const CustomInstruction *custom = entry->instruction;
+        if ((custom->funct7 == CUSTOM_ANY || custom->funct7 == instruction.rtype.funct7) &&
+            (custom->match == NULL || custom->match(instruction))) {
+            return custom;
+        }
+    }
+    return NULL;
+}
+
+int load_plugin(const char *path) {
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+        fprintf(stderr, "Cannot load plugin %s: %s\n", path, dlerror());
+        return -1;
+    }
+    PluginInit init = (PluginInit)dlsym(handle, PLUGIN_ENTRY);
+    if (init == NULL) {
+        fprintf(stderr, "Plugin %s has no %s()\n", path, PLUGIN_ENTRY);
+        dlclose(handle);
+        return -1;
+    }
+    if (init() != 0) {
+        fprintf(stderr, "Plugin %s failed to register its instructions\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Built-in custom instructions on opcode 0x2a */
+
+/* lsgt rd, rs1, rs2: load the word at rs2 into rd if rs1 is greater */
+static void execute_lsgt(Instruction instruction, Processor *processor, Byte *memory) {
+    if (!check_address(processor, processor->R[instruction.rtype.rs2], LENGTH_WORD)) {
+        return;
+    }
+    if ((sWord)processor->R[instruction.rtype.rs1] >
+        load(memory, (sWord)processor->R[instruction.rtype.rs2], LENGTH_WORD)) {
+
+            processor->R[instruction.rtype.rd] =
+                load(
+                    memory,
+                    ((sWord)processor->R[instruction.rtype.rs2]),
+                    LENGTH_WORD
+                    );
+        }
+}
+
+/* slt rd, rs1, rs2: load the word at rs2 into rd if rs1 is less (signed) */
+static void execute_lslt(Instruction instruction, Processor *processor, Byte *memory) {
+    if (!check_address(processor, processor->R[instruction.rtype.rs2], LENGTH_WORD)) {
+        return;
+    }
+    if ((sWord)processor->R[instruction.rtype.rs1] <
+        (sWord)load(memory, (sWord)processor->R[instruction.rtype.rs2], LENGTH_WORD)) {
+
+            processor->R[instruction.rtype.rd] =
+                load(
+                    memory,
+                    ((sWord)processor->R[instruction.rtype.rs2]),
+                    LENGTH_WORD
+                    );
+        }
+}
+
+/* Array reductions on custom-0 (0x0b): rs1 holds the address of an array of
+   signed words and rs2 its length, and rd is the accumulator. Each one
+   retires as a single instruction and is charged one cycle, plus one more
+   for every VLEN-bit block of memory it reads. */
+
+#define WORDS_PER_BLOCK (VLENB / LENGTH_WORD)
+
+/* Checks the array is inside guest memory, charges the extra cycles, and
+   returns the host address of the array, or NULL after stopping the hart */
+static const Byte *reduction_array(Instruction instruction, Processor *processor, Byte *memory,
+                                   Word *length) {
+    Address base = processor->R[instruction.rtype.rs1];
+    *length = processor->R[instruction.rtype.rs2];
+    if (base > MEMORY_SPACE || *length > (MEMORY_SPACE - base) / LENGTH_WORD) {
+        processor->status = EMULATOR_INVALID_ADDRESS;
+        processor->fault_address = base;
+        return NULL;
+    }
+    processor->stall += ((Double)*length + WORDS_PER_BLOCK - 1) / WORDS_PER_BLOCK;
+    return memory + base;
+}
+
+/* Folds the array into init one vector register's worth at a time; the
+   tail is padded with the identity of op */
+static Word reduce_array(VectorOp op, const Byte *array, Word length, Word init) {
+    Byte block[VLENB];
+    Word i;
+    for (i = 0; i + WORDS_PER_BLOCK <= length; i += WORDS_PER_BLOCK) {
+        init = vector_reduce(op, LENGTH_WORD, array + i * LENGTH_WORD, init);
+    }
+    if (i < length) {
+        for (unsigned j = 0; j < WORDS_PER_BLOCK; j++) {
+            vector_set_element(block, j, LENGTH_WORD, vector_identity(op, LENGTH_WORD));
+        }
+        memcpy(block, array + i * LENGTH_WORD, (length - i) * LENGTH_WORD);
+        init = vector_reduce(op, LENGTH_WORD, block, init);
+    }
+    return init;
+}
+
+static void execute_reduction(VectorOp op, Instruction instruction, Processor *processor,
+                              Byte *memory) {
+    Word length;
+    const Byte *array = reduction_array(instruction, processor, memory, &length);
+    if (array == NULL) {
+        return;
+    }
+    processor->R[instruction.rtype.rd] =
+        reduce_array(op, array, length, processor->R[instruction.rtype.rd]);
+}
+
+/* rmax rd, rs1, rs2: rd = max(rd, array) */
+static void execute_rmax(Instruction instruction, Processor *processor, Byte *memory) {
+    execute_reduction(VECTOR_MAX, instruction, processor, memory);
+}
+
+/* rmin rd, rs1, rs2: rd = min(rd, array) */
+static void execute_rmin(Instruction instruction, Processor *processor, Byte *memory) {
+    execute_reduction(VECTOR_MIN, instruction, processor, memory);
+}
+
+/* rsum rd, rs1, rs2: rd += sum(array) */
+static void execute_rsum(Instruction instruction, Processor *processor, Byte *memory) {
+    execute_reduction(VECTOR_ADD, instruction, processor, memory);
+}
+
+/* rcntgt rd, rs1, rs2: rd = the number of elements greater than rd */
+static void execute_rcntgt(Instruction instruction, Processor *processor, Byte *memory) {
+    Byte threshold[VLENB];
+    Byte block[VLENB];
+    Word length, count = 0;
+    const Byte *array = reduction_array(instruction, processor, memory, &length);
+    if (array == NULL) {
+        return;
+    }
+
+    for (unsigned j = 0; j < WORDS_PER_BLOCK; j++) {
+        vector_set_element(threshold, j, LENGTH_WORD, processor->R[instruction.rtype.rd]);
+    }
+    for (Word i = 0; i < length; i += WORDS_PER_BLOCK) {
+        Word mask = 0xFFFFFFFF;
+        const Byte *words = array + i * LENGTH_WORD;
+        if (length - i < WORDS_PER_BLOCK) {
+            memset(block, 0, VLENB);
+            memcpy(block, words, (length - i) * LENGTH_WORD);
+            mask = (1U << (length - i)) - 1;
+            words = block;
+        }
+        count += __builtin_popcount(
+            vector_compare(VECTOR_GT, LENGTH_WORD, words, threshold) & mask);
+    }
+    processor->R[instruction.rtype.rd] = count;
+}
+
+static const CustomInstruction builtins[] = {
+    {"lsgt", 0x2a, 0x2, CUSTOM_ANY, NULL, NULL, execute_lsgt},
+    {"slt", 0x2a, 0x4, CUSTOM_ANY, NULL, NULL, execute_lslt},
+    {"rmax", 0x0b, 0x0, 0x0, NULL, NULL, execute_rmax},
+    {"rmin", 0x0b, 0x1, 0x0, NULL, NULL, execute_rmin},
+    {"rsum", 0x0b, 0x2, 0x0, NULL, NULL, execute_rsum},
+    {"rcntgt", 0x0b, 0x3, 0x0, NULL, NULL, execute_rcntgt},
+};
+
+static void register_builtins(void) {
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+        add_custom_instruction(&builtins[i]);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef CUSTOM_H
+#define CUSTOM_H
+
+#include "types.h"
+#include "emulator.h"
+
+/* Matches any funct3 or funct7 value */
+#define CUSTOM_ANY (-1)
+
+/* A custom instruction living in one of the custom opcode spaces
+   (custom-0..3: 0x0b, 0x2b, 0x5b, 0x7b) or our legacy 0x2a space.
+   Instructions in these spaces are parsed as R-type; anything else can be
+   decoded from instruction.bits. */
+typedef struct {
+    const char *name;
+    int opcode;
+    int funct3; /* or CUSTOM_ANY */
+    int funct7; /* or CUSTOM_ANY */
+
+    /* optional: claims only some of the encodings that matched the fields
+       above, for plugins with their own operand formats */
+    int (*match)(Instruction);
+
+    /* optional: prints the disassembly line; defaults to R-type syntax */
+    void (*disassemble)(const char *name, Instruction);
+
+    /* sets processor->status to stop the hart, e.g. on a bad operand */
+    void (*execute)(Instruction, Processor *, Byte *);
+} CustomInstruction;
+
+/* Adds an instruction to the dispatch table. The descriptor is not copied,
+   so it must outlive the emulator (plugins use static storage). Lookups take
+   no lock, so register everything before any harts start. Returns 0, or -1
+   for a bad opcode or an encoding that is already taken. */
+int register_custom_instruction(const CustomInstruction *);
+
+/* Looks up the instruction for a parsed encoding, or NULL */
+const CustomInstruction *find_custom_instruction(Instruction);
+
+/* Loads a plugin shared object and runs its entry point, which registers
+   the plugin's instructions. Returns 0, or -1 with a message on stderr. */
+int load_plugin(const char *path);
+
+/* Every plugin exports this */
+#define PLUGIN_ENTRY "riscv_plugin_init"
+typedef int (*PluginInit)(void);
+
+#endif
@@ -93,6 +93,62 @@ tests_json = """{
       "python3 compare.py ./code/out/UJ/UJ.trace ./code/ref/UJ/UJ.trace": 10
     }
   },
+  "J": {
+    "Part1": {
+      "./riscv -d ./code/input/J/J.input > ./code/out/J/J.solution": 2,
+      "python3 compare.py ./code/out/J/J.solution ./code/ref/J/J.solution": 10
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e ./code/input/J/J.input > ./code/out/J/J.trace": 2,
+      "python3 compare.py ./code/out/J/J.trace ./code/ref/J/J.trace": 10
+    }
+  },
+  "Zicsr": {
+    "Part1": {
+      "./riscv -d ./code/input/Zicsr/Zicsr.input > ./code/out/Zicsr/Zicsr.solution": 2,
+      "python3 compare.py ./code/out/Zicsr/Zicsr.solution ./code/ref/Zicsr/Zicsr.solution": 10
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e ./code/input/Zicsr/Zicsr.input > ./code/out/Zicsr/Zicsr.trace": 2,
+      "python3 compare.py ./code/out/Zicsr/Zicsr.trace ./code/ref/Zicsr/Zicsr.trace": 10
+    }
+  },
+  "A": {
+    "Part1": {
+      "./riscv -d ./code/input/A/A.input > ./code/out/A/A.solution": 2,
+      "python3 compare.py ./code/out/A/A.solution ./code/ref/A/A.solution": 10
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e -n 1 -a 0,1 ./code/input/A/A.input > ./code/out/A/A.trace": 2,
+      "python3 compare.py ./code/out/A/A.trace ./code/ref/A/A.trace": 10,
+      "timeout 5 ./riscv -e -n 4 -a 0,4 ./code/input/A/A.input > ./code/out/A/A4.out": 2,
+      "python3 compare.py ./code/out/A/A4.out ./code/ref/A/A4.out": 10
+    }
+  },
+  "C": {
+    "Part1": {
+      "./riscv -d ./code/input/C/C.input > ./code/out/C/C.solution": 2,
+      "python3 compare.py ./code/out/C/C.solution ./code/ref/C/C.solution": 10
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e ./code/input/C/C.input > ./code/out/C/C.trace": 2,
+      "python3 compare.py ./code/out/C/C.trace ./code/ref/C/C.trace": 10
+    }
+  },
+  "V": {
+    "Part1": {
+      "./riscv -d ./code/input/V/V.input > ./code/out/V/V.solution": 2,
+      "python3 compare.py ./code/out/V/V.solution ./code/ref/V/V.solution": 10,
+      "./riscv -d ./code/input/bad_vector.input > ./code/out/V/bad_vector.solution": 2,
+      "python3 compare.py ./code/out/V/bad_vector.solution ./code/ref/V/bad_vector.solution": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e -s ./code/input/sgt_data.input -a 0x8,0x3000 ./code/input/V/V.input > ./code/out/V/V.trace": 2,
+      "python3 compare.py ./code/out/V/V.trace ./code/ref/V/V.trace": 10,
+      "! timeout 5 ./riscv -r ./code/input/bad_vector.input > ./code/out/V/bad_vector.trace": 2,
+      "python3 compare.py ./code/out/V/bad_vector.trace ./code/ref/V/bad_vector.trace": 5
+    }
+  },
   "sgt": {
      "Part1": {
        "./riscv -d ./code/input/custom_sgt.input > code/out/custom_sgt.solution": 0,
@@ -103,6 +159,245 @@ tests_json = """{
        "python3 compare.py ./code/out/custom_sgt.trace ./code/ref/custom_sgt.trace": 45
      }
    },
+  "mac": {
+    "Part1": {
+      "./riscv -p ./plugins/accel.so -d ./code/input/custom_mac.input > ./code/out/custom_mac.solution": 0,
+      "python3 compare.py ./code/out/custom_mac.solution ./code/ref/custom_mac.solution": 15
+    },
+    "Part2": {
+      "timeout 5 ./riscv -p ./plugins/accel.so -r ./code/input/custom_mac.input > ./code/out/custom_mac.trace": 0,
+      "python3 compare.py ./code/out/custom_mac.trace ./code/ref/custom_mac.trace": 15
+    }
+  },
+  "acc": {
+    "Part1": {
+      "./riscv -p ./plugins/accel.so -d ./code/input/custom_acc.input > ./code/out/custom_acc.solution": 0,
+      "python3 compare.py ./code/out/custom_acc.solution ./code/ref/custom_acc.solution": 15
+    },
+    "Part2": {
+      "timeout 5 ./riscv -p ./plugins/accel.so -r ./code/input/custom_acc.input > ./code/out/custom_acc.trace": 0,
+      "python3 compare.py ./code/out/custom_acc.trace ./code/ref/custom_acc.trace": 15
+    }
+  },
+  "gep": {
+    "Part1": {
+      "./riscv -p ./plugins/accel.so -d ./code/input/custom_gep.input > ./code/out/custom_gep.solution": 0,
+      "python3 compare.py ./code/out/custom_gep.solution ./code/ref/custom_gep.solution": 15
+    },
+    "Part2": {
+      "timeout 5 ./riscv -p ./plugins/accel.so -r ./code/input/custom_gep.input > ./code/out/custom_gep.trace": 0,
+      "python3 compare.py ./code/out/custom_gep.trace ./code/ref/custom_gep.trace": 15
+    }
+  },
+  "slt": {
+    "Part1": {
+      "./riscv -d ./code/input/custom_slt.input > ./code/out/custom_slt.solution": 0,
+      "python3 compare.py ./code/out/custom_slt.solution ./code/ref/custom_slt.solution": 15
+    },
+    "Part2": {
+      "timeout 5 ./riscv -e -r -s ./code/input/slt_data.input -a 0x8,0x3000 ./code/input/custom_slt.input > ./code/out/custom_slt.trace": 0,
+      "python3 compare.py ./code/out/custom_slt.trace ./code/ref/custom_slt.trace": 15
+    }
+  },
+  "reduce": {
+    "Part1": {
+      "./riscv -d ./code/input/reduce.input > ./code/out/reduce.solution": 2,
+      "python3 compare.py ./code/out/reduce.solution ./code/ref/reduce.solution": 10
+    },
+    "Part2": {
+      "timeout 5 ./riscv -e -r -s ./code/input/sgt_data.input -a 0x8,0x3000 ./code/input/reduce.input > ./code/out/reduce.trace": 2,
+      "python3 compare.py ./code/out/reduce.trace ./code/ref/reduce.trace": 10
+    }
+  },
+  "batch": {
+    "Part1": {
+      "./riscv -d ./code/input/batch.input > ./code/out/batch.solution": 2,
+      "python3 compare.py ./code/out/batch.solution ./code/ref/batch.solution": 10
+    },
+    "Part2": {
+      "timeout 5 ./riscv -e -b ./code/input/batch.jobs ./code/input/batch.input > ./code/out/batch.out": 2,
+      "python3 compare.py ./code/out/batch.out ./code/ref/batch.out": 10,
+      "timeout 5 ./riscv -e -r -b ./code/input/batch.jobs ./code/input/batch.input > ./code/out/batch.trace": 2,
+      "python3 compare.py ./code/out/batch.trace ./code/ref/batch.trace": 10
+    }
+  },
+  "sweep": {
+    "Part1": {
+      "timeout 5 ./riscv -e --sweep ./code/input/single.jobs ./code/input/batch.input > ./code/out/sweep.single": 2,
+      "python3 compare.py ./code/out/sweep.single ./code/ref/single.out": 5,
+      "! ./riscv -e --sweep ./code/input/missing.jobs ./code/input/batch.input": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -e --sweep ./code/input/batch.jobs ./code/input/batch.input > ./code/out/sweep.out": 2,
+      "python3 compare.py ./code/out/sweep.out ./code/ref/batch.out": 10,
+      "timeout 5 ./riscv -e -r --sweep ./code/input/batch.jobs ./code/input/batch.input > ./code/out/sweep.trace": 2,
+      "python3 compare.py ./code/out/sweep.trace ./code/ref/batch.trace": 10
+    }
+  },
+  "serve": {
+    "Part1": {
+      "! timeout 5 ./riscv --client ./code/out/nobody.sock < ./code/input/serve.jobs": 2
+    },
+    "Part2": {
+      "timeout 5 sh -c './riscv --serve ./code/out/riscv.sock > /dev/null & ./riscv --client ./code/out/riscv.sock < ./code/input/serve.jobs > ./code/out/serve.out'": 2,
+      "python3 compare.py ./code/out/serve.out ./code/ref/serve.out": 10,
+      "timeout 5 sh -c './riscv --serve ./code/out/fault.sock > /dev/null & ! ./riscv --client ./code/out/fault.sock < ./code/input/serve_fault.jobs > ./code/out/serve_fault.out && ./riscv --client ./code/out/fault.sock < ./code/input/serve_again.jobs >> ./code/out/serve_fault.out'": 2,
+      "python3 compare.py ./code/out/serve_fault.out ./code/ref/serve_fault.out": 5
+    }
+  },
+  "fork-server": {
+    "Part1": {
+      "timeout 5 ./riscv -e --fork-server ./code/input/batch.input < ./code/input/single.jobs > ./code/out/fork.single": 2,
+      "python3 compare.py ./code/out/fork.single ./code/ref/single.out": 5
+    },
+    "Part2": {
+      "timeout 5 ./riscv -e --fork-server ./code/input/batch.input < ./code/input/batch.jobs > ./code/out/fork.out": 2,
+      "python3 compare.py ./code/out/fork.out ./code/ref/batch.out": 10,
+      "timeout 5 ./riscv -e -r --fork-server ./code/input/batch.input < ./code/input/batch.jobs > ./code/out/fork.trace": 2,
+      "python3 compare.py ./code/out/fork.trace ./code/ref/batch.trace": 10
+    }
+  },
+  "shared-image": {
+    "Part1": {
+      "./riscv --shared-image ./code/out -d ./code/input/reduce.input > ./code/out/shared.solution": 2,
+      "python3 compare.py ./code/out/shared.solution ./code/ref/reduce.solution": 5
+    },
+    "Part2": {
+      "timeout 5 ./riscv --shared-image ./code/out -e -r -s ./code/input/sgt_data.input -a 0x8,0x3000 ./code/input/reduce.input > ./code/out/shared.trace": 2,
+      "python3 compare.py ./code/out/shared.trace ./code/ref/reduce.trace": 10,
+      "timeout 5 ./riscv --shared-image ./code/out -e -r -s ./code/input/sgt_data.input -a 0x8,0x3000 ./code/input/reduce.input > ./code/out/shared2.trace": 2,
+      "python3 compare.py ./code/out/shared2.trace ./code/ref/reduce.trace": 10
+    }
+  },
+  "checkpoint": {
+    "Part1": {
+      "! ./riscv -e --checkpoint-at 5": 2,
+      "! ./riscv -e --restore ./code/input/batch.jobs": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -e -r -s ./code/input/sgt_data.input -a 0x8,0x3000 --checkpoint-at 5 ./code/out/reduce.checkpoint ./code/input/reduce.input > ./code/out/checkpoint.trace": 2,
+      "python3 compare.py ./code/out/checkpoint.trace ./code/ref/reduce.trace": 10,
+      "timeout 5 ./riscv -e -r --restore ./code/out/reduce.checkpoint > ./code/out/reduce.restore": 2,
+      "python3 compare.py ./code/out/reduce.restore ./code/ref/reduce.restore": 10
+    }
+  },
+  "reverse": {
+    "Part1": {
+      "timeout 5 ./riscv -i -a 0,1 ./code/input/A/A.input < /dev/null > ./code/out/reverse.plain": 2,
+      "python3 compare.py ./code/out/reverse.plain ./code/ref/reverse.plain": 5,
+      "! timeout 5 ./riscv -e -i --checkpoint-at 4 ./code/out/reverse.checkpoint ./code/input/A/A.input < /dev/null": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -e -r -i --snapshot-every 4 -a 0,1 ./code/input/A/A.input < ./code/input/reverse.cmds > ./code/out/reverse.out": 2,
+      "python3 compare.py ./code/out/reverse.out ./code/ref/reverse.out": 10
+    }
+  },
+  "gdb": {
+    "Part1": {
+      "! timeout 5 ./riscv -n 2 --gdb ./code/out/gdb.sock ./code/input/batch.input": 2
+    },
+    "Part2": {
+      "./riscv -a 4,3 --gdb ./code/out/gdb.sock ./code/input/batch.input > ./code/out/gdb.run & timeout 5 python3 gdb_client.py ./code/out/gdb.sock < ./code/input/gdb.packets > ./code/out/gdb.out; wait": 2,
+      "python3 compare.py ./code/out/gdb.out ./code/ref/gdb.out": 5,
+      "python3 compare.py ./code/out/gdb.run ./code/ref/gdb.run": 5,
+      "./riscv --gdb ./code/out/gdb_ebreak.sock ./code/input/gdb_ebreak.input > ./code/out/gdb_ebreak.run & timeout 5 python3 gdb_client.py ./code/out/gdb_ebreak.sock < ./code/input/gdb_ebreak.packets > ./code/out/gdb_ebreak.out; wait": 2,
+      "python3 compare.py ./code/out/gdb_ebreak.out ./code/ref/gdb_ebreak.out": 5,
+      "python3 compare.py ./code/out/gdb_ebreak.run ./code/ref/gdb_ebreak.run": 2
+    }
+  },
+  "watch": {
+    "Part1": {
+      "! ./riscv -e -n 2 --watch 4000 ./code/input/A/A.input": 2,
+      "! ./riscv -e --watch zz ./code/input/A/A.input": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -e -a 0,1 --watch 4000 --watch 4008 --watch 4004,2 ./code/input/A/A.input > ./code/out/watch.out": 2,
+      "python3 compare.py ./code/out/watch.out ./code/ref/watch.out": 10
+    }
+  },
+  "binary-trace": {
+    "Part1": {
+      "! ./riscv -e --binary-trace ./code/input/A/A.input": 2,
+      "! ./riscv --decode-trace ./code/input/A/A.input": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e -n 1 -a 0,1 --binary-trace ./code/input/A/A.input > ./code/out/A.bintrace": 2,
+      "./riscv --decode-trace ./code/out/A.bintrace > ./code/out/A.decoded": 2,
+      "python3 compare.py ./code/out/A.decoded ./code/ref/A/A.trace": 5,
+      "timeout 5 ./riscv -r -e --binary-trace ./code/input/multiply.input > ./code/out/multiply.bintrace": 2,
+      "./riscv --decode-trace ./code/out/multiply.bintrace > ./code/out/multiply.decoded": 2,
+      "python3 compare.py ./code/out/multiply.decoded ./code/ref/multiply.trace": 5
+    }
+  },
+  "async-trace": {
+    "Part1": {
+      "! ./riscv -e --async-trace ./code/input/A/A.input": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e -n 1 -a 0,1 --async-trace ./code/input/A/A.input > ./code/out/A.async.trace": 2,
+      "python3 compare.py ./code/out/A.async.trace ./code/ref/A/A.trace": 5,
+      "timeout 5 ./riscv -r -e --async-trace --binary-trace ./code/input/multiply.input > ./code/out/multiply.async.bintrace": 2,
+      "./riscv --decode-trace ./code/out/multiply.async.bintrace > ./code/out/multiply.async.decoded": 2,
+      "python3 compare.py ./code/out/multiply.async.decoded ./code/ref/multiply.trace": 5
+    }
+  },
+  "trace-at": {
+    "Part1": {
+      "! ./riscv --trace-at 20 ./code/ref/multiply.trace": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e --binary-trace ./code/input/multiply.input > ./code/out/trace-at.bintrace": 2,
+      "./riscv --trace-at 20 ./code/out/trace-at.bintrace > ./code/out/trace-at.out": 2,
+      "python3 compare.py ./code/out/trace-at.out ./code/ref/trace-at.out": 5
+    }
+  },
+  "expect": {
+    "Part1": {
+      "! ./riscv -r -e --expect ./code/input/missing.trace ./code/input/A/A.input": 2,
+      "! ./riscv -r -e --expect ./code/ref/A/A.trace --binary-trace ./code/input/A/A.input": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e -n 1 -a 0,1 --expect ./code/ref/A/A.trace ./code/input/A/A.input > ./code/out/expect.out": 2,
+      "python3 compare.py ./code/out/expect.out ./code/ref/expect.out": 5,
+      "! timeout 5 ./riscv -r -e -a 0,1 --expect ./code/ref/multiply.trace ./code/input/multiply.input > ./code/out/expect.diverged": 2,
+      "python3 compare.py ./code/out/expect.diverged ./code/ref/expect.diverged": 5
+    }
+  },
+  "trace-filters": {
+    "Part1": {
+      "! ./riscv -r -e --trace-window 30,10 ./code/input/multiply.input": 2,
+      "! ./riscv -r -e --trace-registers 40 ./code/input/multiply.input": 2,
+      "! ./riscv -r -e --trace-registers 10,x ./code/input/multiply.input": 2,
+      "! ./riscv -r -e --binary-trace --trace-every 2 ./code/input/multiply.input > /dev/null": 2
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r -e --trace-window 10,30 --trace-every 5 --trace-registers 8,9 ./code/input/multiply.input > ./code/out/trace-window.out": 2,
+      "python3 compare.py ./code/out/trace-window.out ./code/ref/trace-window.out": 5,
+      "timeout 5 ./riscv -r -e -n 1 -a 0,1 --trace-ecalls 1 --trace-pc 1000,1100 --trace-registers 10,17 ./code/input/A/A.input > ./code/out/trace-ecalls.out": 2,
+      "python3 compare.py ./code/out/trace-ecalls.out ./code/ref/trace-ecalls.out": 5
+    }
+  },
+  "bad-address": {
+    "Part1": {
+      "./riscv -d ./code/input/bad_load.input > ./code/out/bad_address.solution": 2,
+      "python3 compare.py ./code/out/bad_address.solution ./code/ref/bad_address.solution": 3
+    },
+    "Part2": {
+      "! timeout 5 ./riscv -r ./code/input/bad_load.input > ./code/out/bad_address.out": 2,
+      "! timeout 5 ./riscv -e ./code/input/bad_jump.input >> ./code/out/bad_address.out": 2,
+      "python3 compare.py ./code/out/bad_address.out ./code/ref/bad_address.out": 5
+    }
+  },
+  "divide": {
+    "Part1": {
+      "./riscv -d ./code/input/divide.input > ./code/out/divide.solution": 2,
+      "python3 compare.py ./code/out/divide.solution ./code/ref/divide.solution": 5
+    },
+    "Part2": {
+      "timeout 5 ./riscv -r ./code/input/divide.input > ./code/out/divide.trace": 2,
+      "python3 compare.py ./code/out/divide.trace ./code/ref/divide.trace": 5
+    }
+  },
   "All": {
     "Part1": {
       "./riscv -d ./code/input/simple.input > ./code/out/simple.solution": 0,
@@ -125,37 +420,6 @@ tests_json = """{
 """
 
 
-  # "mac": {
-  #   "Part1": {
-  #     "./riscv -d ./code/input/custom_mac.input > ./code/out/custom_mac.solution": 0,
-  #     "python3 compare.py ./code/out/custom_mac.solution ./code/ref/custom_mac.solution": 15
-  #   },
-  #   "Part2": {
-  #     "timeout 5 ./riscv -r ./code/input/custom_mac.input > ./code/out/custom_mac.trace": 0,
-  #     "python3 compare.py ./code/out/custom_mac.trace ./code/ref/custom_mac.trace": 15
-  #   }
-  # },
-  # "acc": {
-  #   "Part1": {
-  #     "./riscv -d ./code/input/custom_acc.input > ./code/out/custom_acc.solution": 0,
-  #     "python3 compare.py ./code/out/custom_acc.solution ./code/ref/custom_acc.solution": 15
-  #   },
-  #   "Part2": {
-  #     "timeout 5 ./riscv -r ./code/input/custom_acc.input > ./code/out/custom_acc.trace": 0,
-  #     "python3 compare.py ./code/out/custom_acc.trace ./code/ref/custom_acc.trace": 15
-  #   }
-  # },
-  # "gep": {
-  #   "Part1": {
-  #     "./riscv -d ./code/input/custom_gep.input > ./code/out/custom_gep.solution": 0,
-  #     "python3 compare.py ./code/out/custom_gep.solution ./code/ref/custom_gep.solution": 15
-  #   },
-  #   "Part2": {
-  #     "timeout 5 ./riscv -r ./code/input/custom_gep.input > ./code/out/custom_gep.trace": 0,
-  #     "python3 compare.py ./code/out/custom_gep.trace ./code/ref/custom_gep.trace": 15
-  #   }
-  # },
-
 
 
 Final = {}
@@ -0,0 +1,330 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "types.h"
+#include "utils.h"
+#include "riscv.h"
+#include "emulator.h"
+#include "memory.h"
+
+#define MAX_SIZE 50
+
+Emulator *emulator_create(void) {
+    Emulator *emulator = calloc(1, sizeof(Emulator));
+    if (emulator == NULL) {
+        return NULL;
+    }
+    emulator->memory = memory_alloc();
+    if (emulator->memory == NULL) {
+        free(emulator);
+        return NULL;
+    }
+    emulator->image = -1;
+
+    Processor *processor = &emulator->harts[0];
+    emulator->nharts = 1;
+
+    /* Set the global pointer to 0x3000. We arbitrarily call this the middle
+     * of the static data segment */
+    processor->R[3] = 0x3000;
+
+    /* Set the stack pointer near the top of the memory array */
+    processor->R[2] = 0xEFFFF;
+
+    processor->PC = 0x1000;
+    return emulator;
+}
+
+void emulator_destroy(Emulator *emulator) {
+    if (emulator != NULL) {
+        memory_free(emulator->memory, emulator->mapped);
+        if (emulator->image >= 0) {
+            close(emulator->image);
+        }
+        free(emulator);
+    }
+}
+
+/* Switches the emulator's memory to a private mapping of image, which
+ * must hold the same bytes */
+static void use_image(Emulator *emulator, int image, Byte *memory) {
+    memory_free(emulator->memory, emulator->mapped);
+    if (emulator->image >= 0) {
+        close(emulator->image);
+    }
+    emulator->memory = memory;
+    emulator->mapped = 1;
+    emulator->image = image;
+}
+
+int emulator_freeze(Emulator *emulator) {
+    int image = memfd_create("rv32emu-image", MFD_CLOEXEC);
+    if (image < 0) {
+        return -1;
+    }
+    Byte *memory = memory_write_image(image, emulator->memory, 0) == 0 ? memory_map(image, 0) : NULL;
+    if (memory == NULL) {
+        close(image);
+        return -1;
+    }
+    use_image(emulator, image, memory);
+    return 0;
+}
+
+int emulator_share(Emulator *emulator, const char *directory) {
+    uint64_t hash = 14695981039346656037ULL;
+    char path[4096], temporary[4200];
+
+    // FNV-1a over the offsets and contents of the pages in use
+    for (long offset = 0; offset < MEMORY_SPACE; offset += PAGE_SIZE) {
+        const Byte *bytes = emulator->memory + offset;
+        if (memory_is_zero_page(bytes)) {
+            continue;
+        }
+        for (int i = 0; i < 4; i++) {
+            hash = (hash ^ ((offset >> (8 * i)) & 0xFF)) * 1099511628211ULL;
+        }
+        for (long i = 0; i < PAGE_SIZE; i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+    }
+    snprintf(path, sizeof(path), "%s/rv32emu-%016llx.img", directory, (unsigned long long)hash);
+
+    int image = open(path, O_RDONLY | O_CLOEXEC);
+    if (image < 0) {
+        /* write the image under a name of our own, then move it into place
+         * so other processes never see it half written */
+        snprintf(temporary, sizeof(temporary), "%s.%d", path, (int)getpid());
+        image = open(temporary, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (image < 0) {
+            return emulator_freeze(emulator);
+        }
+        if (memory_write_image(image, emulator->memory, 0) != 0 || rename(temporary, path) != 0) {
+            unlink(temporary);
+            close(image);
+            return emulator_freeze(emulator);
+        }
+    }
+
+    /* an image left by another process must hold the same pages; they
+     * are read rather than mapped, so the check does not fault them in */
+    Byte buffer[PAGE_SIZE];
+    for (long offset = 0; offset < MEMORY_SPACE; offset += PAGE_SIZE) {
+        const Byte *bytes = emulator->memory + offset;
+        if (!memory_is_zero_page(bytes) &&
+            (pread(image, buffer, PAGE_SIZE, offset) != PAGE_SIZE ||
+             memcmp(buffer, bytes, PAGE_SIZE) != 0)) {
+            close(image);
+            return emulator_freeze(emulator);
+        }
+    }
+
+    Byte *memory = memory_map(image, 0);
+    if (memory == NULL) {
+        close(image);
+        return emulator_freeze(emulator);
+    }
+    use_image(emulator, image, memory);
+    return 0;
+}
+
+int emulator_reset(Emulator *emulator, const Emulator *frozen) {
+    Byte *memory = emulator->memory;
+    if (memory_remap(memory, frozen->image, 0) != 0) {
+        return -1;
+    }
+    *emulator = *frozen;
+    emulator->memory = memory;
+    emulator->image = -1;
+    emulator->stop = 0;
+    return 0;
+}
+
+Emulator *emulator_clone(const Emulator *frozen) {
+    Emulator *emulator = malloc(sizeof(Emulator));
+    if (emulator == NULL) {
+        return NULL;
+    }
+    *emulator = *frozen;
+    emulator->memory = memory_map(frozen->image, 0);
+    if (emulator->memory == NULL) {
+        free(emulator);
+        return NULL;
+    }
+    emulator->image = -1;
+    emulator->stop = 0;
+    return emulator;
+}
+
+/* Returns the number of bytes a line of the input file occupies in memory.
+ * For programs (code set) a line of at most four hex digits is a 16-bit RVC
+ * parcel; data files are always loaded as whole words. */
+static int line_length(const char *line, int code) {
+    if (line[0] == '0' && (line[1] == 'x' || line[1] == 'X')) {
+        line += 2;
+    }
+    size_t ndigits = strspn(line, "0123456789abcdefABCDEF");
+    return (code && ndigits > 0 && ndigits <= 4) ? 2 : 4;
+}
+
+int emulator_load(Emulator *emulator, const char *filename, Address address, int code) {
+    FILE *file = fopen(filename, "r");
+    char line[MAX_SIZE];
+    int value, offset = 0;
+    int size = 0;
+    if (file == NULL) {
+        return -1;
+    }
+    if (code) {
+        while (fgets(line, MAX_SIZE, file) != NULL) {
+            if (line_length(line, code) == 2) {
+                emulator->compressed = 1;
+            }
+        }
+        rewind(file);
+    }
+    while (fgets(line, MAX_SIZE, file) != NULL) {
+        int length = line_length(line, code);
+        if (address + offset + length > MEMORY_SPACE) {
+            break;
+        }
+        value = (int32_t)strtol(line, NULL, 16);
+        size++;
+        store(emulator->memory, address + offset, length == 2 ? LENGTH_HALF_WORD : LENGTH_WORD,
+              value);
+        offset += length;
+    }
+    fclose(file);
+    return size;
+}
+
+int emulator_start_harts(Emulator *emulator, int n) {
+    if (n < 1 || n > EMULATOR_MAX_HARTS) {
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        emulator->harts[i] = emulator->harts[0];
+        emulator->harts[i].R[10] = i;
+    }
+    emulator->nharts = n;
+    return 0;
+}
+
+int emulator_fetch(const Emulator *emulator, Address address, uint32_t *instruction_bits) {
+    if (address > MEMORY_SPACE - LENGTH_HALF_WORD) {
+        return 0;
+    }
+    *instruction_bits = load(emulator->memory, address, LENGTH_HALF_WORD);
+    if (is_compressed(*instruction_bits, emulator->compressed)) {
+        return 2;
+    }
+    if (address > MEMORY_SPACE - LENGTH_WORD) {
+        return 0;
+    }
+    *instruction_bits |= load(emulator->memory, address + 2, LENGTH_HALF_WORD) << 16;
+    return 4;
+}
+
+/* Runs one hart on the calling thread */
+static EmulatorStatus run_hart(Emulator *emulator, Processor *processor, Double budget,
+                               Double *retired) {
+    EmulatorStatus status = EMULATOR_RUNNING;
+    Double count;
+
+    for (count = 0; count < budget && !__atomic_load_n(&emulator->stop, __ATOMIC_RELAXED);
+         count++) {
+        uint32_t instruction_bits = 0;
+        if (emulator_fetch(emulator, processor->PC, &instruction_bits) == 0) {
+            // a jump out of guest memory stops the hart before it retires
+            status = processor->status = EMULATOR_INVALID_ADDRESS;
+            processor->fault_address = processor->PC;
+        } else {
+            status = execute_instruction(instruction_bits, processor, emulator);
+        }
+        if (status != EMULATOR_RUNNING) {
+            // only the first hart to stop reports why
+            if (!__atomic_exchange_n(&emulator->stop, 1, __ATOMIC_ACQ_REL)) {
+                emulator->fault = instruction_bits;
+                emulator->fault_address = processor->fault_address;
+            } else {
+                status = EMULATOR_RUNNING;
+            }
+            break;
+        }
+
+        // enforce $0 being hard-wired to 0
+        processor->R[0] = 0;
+
+        /* each instruction takes one cycle; custom instructions that model
+         * longer-running hardware add their extra cycles to the stall count */
+        processor->instret++;
+        if (emulator->pause_on_ecall && instruction_bits == 0x00000073) {
+            count++;
+            break;
+        }
+    }
+    *retired = count;
+    return status;
+}
+
+typedef struct {
+    Emulator *emulator;
+    Processor *processor;
+    Double budget;
+    Double retired;
+    EmulatorStatus status;
+    pthread_t thread;
+} HartThread;
+
+static void *hart_thread(void *arg) {
+    HartThread *hart = arg;
+    hart->status = run_hart(hart->emulator, hart->processor, hart->budget, &hart->retired);
+    return NULL;
+}
+
+EmulatorStatus emulator_run(Emulator *emulator, Double budget, Double *retired) {
+    HartThread harts[EMULATOR_MAX_HARTS];
+    EmulatorStatus status = EMULATOR_RUNNING;
+    Double count = 0;
+    int started;
+
+    emulator->stop = 0;
+    if (emulator->nharts == 1) {
+        status = run_hart(emulator, &emulator->harts[0], budget, &count);
+    } else {
+        for (started = 0; started < emulator->nharts; started++) {
+            HartThread *hart = &harts[started];
+            hart->emulator = emulator;
+            hart->processor = &emulator->harts[started];
+            hart->budget = budget;
+            if (pthread_create(&hart->thread, NULL, hart_thread, hart) != 0) {
+                // run what could be started; the rest wait for the next run
+                break;
+            }
+        }
+        for (int i = 0; i < started; i++) {
+            pthread_join(harts[i].thread, NULL);
+            count += harts[i].retired;
+            if (harts[i].status != EMULATOR_RUNNING) {
+                status = harts[i].status;
+            }
+        }
+    }
+    if (retired != NULL) {
+        *retired += count;
+    }
+    return status;
+}
+
+void emulator_print(Emulator *emulator, const char *text, size_t length) {
+    if (emulator->output != NULL) {
+        emulator->output(emulator->output_opaque, text, length);
+    } else {
+        fwrite(text, 1, length, stdout);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef EMULATOR_H
+#define EMULATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+/* Why emulator_run() returned. An instruction that stops the hart leaves the
+   reason in Processor.status and does not retire. */
+typedef enum {
+    EMULATOR_RUNNING = 0,          /* the budget ran out */
+    EMULATOR_EXITED,               /* the guest made the exit ecall */
+    EMULATOR_INVALID_INSTRUCTION,  /* the encoding is in Emulator.fault */
+    EMULATOR_ILLEGAL_ECALL,        /* the ecall number is in a0 */
+    EMULATOR_BREAKPOINT,           /* an ebreak, such as one a debugger placed */
+    EMULATOR_INVALID_ADDRESS,      /* outside guest memory; see Emulator.fault_address */
+} EmulatorStatus;
+
+/* Budget for emulator_run() that never runs out */
+#define EMULATOR_FOREVER UINT64_MAX
+
+/* Most harts one emulator can run */
+#define EMULATOR_MAX_HARTS 64
+
+/* Receives everything the guest prints through ecalls */
+typedef void (*EmulatorOutput)(void *opaque, const char *text, size_t length);
+
+/* One emulated machine. Nothing here is shared between instances, so any
+   number of them can live in one process. */
+typedef struct Emulator {
+    Processor harts[EMULATOR_MAX_HARTS];
+    int nharts;                 /* harts in use, 1 unless emulator_start_harts() */
+    int stop;                   /* set by the first hart that stops */
+    int pause_on_ecall;         /* emulator_run() returns once an ecall retires */
+    Byte *memory;               /* MEMORY_SPACE bytes, shared by all harts */
+    int compressed;             /* the C extension is on */
+    EmulatorOutput output;      /* NULL writes to stdout */
+    void *output_opaque;
+    Word fault;                 /* the instruction behind the last status */
+    Address fault_address;      /* the address behind EMULATOR_INVALID_ADDRESS */
+    int mapped;                 /* memory maps an image (see memory_map()) */
+    int image;                  /* memfd behind a frozen emulator, or -1 */
+} Emulator;
+
+/* Creates a machine with zeroed memory and registers, PC at 0x1000 and
+   the stack and global pointers set as the simulator always has. Returns
+   NULL if memory cannot be allocated. */
+Emulator *emulator_create(void);
+void emulator_destroy(Emulator *);
+
+/* Loads one hex value per line of filename at address. A program (code
+   set) with any 16-bit line turns on the C extension. Returns the number of
+   lines, or -1 if the file cannot be read. */
+int emulator_load(Emulator *, const char *filename, Address address, int code);
+
+/* Moves the memory into an image that clones map copy-on-write, so a
+   loaded program is shared by any number of instances. The emulator keeps
+   working on its own private mapping. Returns 0, or -1 on failure. */
+int emulator_freeze(Emulator *);
+
+/* Like emulator_freeze(), but the image is a file in directory named after
+   its contents, which any process that loads the same memory maps too, so
+   they all share its clean pages. Pages become private to a process when
+   it writes them, as for any frozen emulator. Falls back to a private
+   image if the directory cannot be used. Returns 0, or -1 on failure. */
+int emulator_share(Emulator *, const char *directory);
+
+/* Creates a machine that starts as a copy of a frozen one: the same harts
+   and output, and memory that shares the image's pages until they are
+   written. Returns NULL on failure. */
+Emulator *emulator_clone(const Emulator *);
+
+/* Returns a clone to the state of a frozen emulator, which need not be
+   the one it was cloned from. Its written pages are dropped, so this is
+   much cheaper than a new clone. Returns 0, or -1 on failure. */
+int emulator_reset(Emulator *clone, const Emulator *frozen);
+
+/* Makes n harts that start as copies of hart 0, each with its hart ID in
+   a0. Returns 0, or -1 if n is out of range. */
+int emulator_start_harts(Emulator *, int n);
+
+/* Reads the instruction at address into *instruction_bits: a 16-bit parcel
+   first, then the upper half unless the low bits mark it as compressed (RVC).
+   Returns its length in bytes, or 0 if it does not lie in guest memory. */
+int emulator_fetch(const Emulator *, Address address, uint32_t *instruction_bits);
+
+/* Runs until the guest stops or each hart has retired budget instructions,
+   and adds the number retired to *retired unless it is NULL. With more than
+   one hart, each runs on its own host thread, and the first one to stop
+   stops the rest; its status is returned. */
+EmulatorStatus emulator_run(Emulator *, Double budget, Double *retired);
+
+/* Sends guest output to the emulator's callback */
+void emulator_print(Emulator *, const char *text, size_t length);
+
+#endif
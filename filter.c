@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include "types.h"
+#include "emulator.h"
+#include "snapshot.h"
+#include "trace.h"
+#include "filter.h"
+
+/* The stretches [first, last] of steps within around of an ecall */
+typedef struct {
+    Double first, last;
+} Window;
+
+typedef struct {
+    Window *windows;
+    size_t count;
+    size_t capacity;
+    Double kept_until;          /* past the window of the last ecall in the budget */
+} Windows;
+
+void trace_filter_init(TraceFilter *filter) {
+    filter->start = 0;
+    filter->end = EMULATOR_FOREVER;
+    filter->every = 1;
+    filter->low = 0;
+    filter->high = (Double)1 << 32;
+    filter->ecalls = 0;
+    filter->around = 0;
+    filter->registers = TRACE_ALL_REGISTERS;
+    filter->kept_until = 0;
+}
+
+int trace_filter_active(const TraceFilter *filter) {
+    return filter->start != 0 || filter->end != EMULATOR_FOREVER || filter->every != 1 ||
+           filter->low != 0 || filter->high != (Double)1 << 32 || filter->ecalls;
+}
+
+static void discard_output(void *opaque, const char *text, size_t length) {
+    (void)opaque;
+    (void)text;
+    (void)length;
+}
+
+/* Adds the window around the ecall at index, merging it with the last one
+   when they touch. Returns 0, or -1 if out of memory. */
+static int add_window(Windows *windows, Double index, Double around) {
+    Window window = {index > around ? index - around : 0, index + around};
+    if (windows->count > 0 && windows->windows[windows->count - 1].last + 1 >= window.first) {
+        windows->windows[windows->count - 1].last = window.last;
+        return 0;
+    }
+    if (windows->count == windows->capacity) {
+        size_t capacity = windows->capacity ? windows->capacity * 2 : 64;
+        Window *grown = realloc(windows->windows, capacity * sizeof(Window));
+        if (grown == NULL) {
+            return -1;
+        }
+        windows->windows = grown;
+        windows->capacity = capacity;
+    }
+    windows->windows[windows->count++] = window;
+    return 0;
+}
+
+/* a + b, or EMULATOR_FOREVER if that overflows */
+static Double saturating_add(Double a, Double b) {
+    return a < EMULATOR_FOREVER - b ? a + b : EMULATOR_FOREVER;
+}
+
+/* Runs ahead at full speed, pausing at each ecall to note its window, and
+   puts the machine back. The run goes around past the budget, since the
+   steps before an ecall there are kept too. */
+static int find_ecalls(TraceFilter *filter, Emulator *emulator, Double budget,
+                       Windows *windows) {
+    Processor *hart = &emulator->harts[0];
+    EmulatorSnapshot *snapshot = emulator_snapshot(emulator);
+    EmulatorOutput output = emulator->output;
+    EmulatorStatus status = EMULATOR_RUNNING;
+    Double start = hart->instret;
+    // one more, so an ecall as the last of them still stops the run early
+    Double until = saturating_add(filter->end, saturating_add(filter->around, 1));
+    Double ahead = saturating_add(budget, saturating_add(filter->around, 1));
+    int result = 0;
+
+    if (until < saturating_add(start, ahead)) {
+        ahead = until > start ? until - start : 0;
+    }
+
+    if (snapshot == NULL) {
+        return -1;
+    }
+    // the steps after an ecall in an earlier run are kept as well
+    if (filter->kept_until > start) {
+        windows->windows = malloc(sizeof(Window));
+        if (windows->windows == NULL) {
+            emulator_snapshot_free(snapshot);
+            return -1;
+        }
+        windows->windows[0] = (Window){start, filter->kept_until - 1};
+        windows->count = windows->capacity = 1;
+    }
+
+    emulator->output = discard_output;
+    emulator->pause_on_ecall = 1;
+    while (status == EMULATOR_RUNNING && hart->instret - start < ahead) {
+        Double retired = 0;
+        Double left = ahead - (hart->instret - start);
+        status = emulator_run(emulator, left, &retired);
+        // only an ecall stops a run early without a status
+        if (status != EMULATOR_RUNNING || retired == left) {
+            continue;
+        }
+        Double ecall = hart->instret - 1;
+        if (add_window(windows, ecall, filter->around) != 0) {
+            result = -1;
+            break;
+        }
+        if (ecall - start < budget) {
+            windows->kept_until = saturating_add(ecall, filter->around + 1);
+        }
+    }
+    emulator->pause_on_ecall = 0;
+    emulator->output = output;
+
+    if (emulator_restore(snapshot) < 0) {
+        result = -1;
+    }
+    emulator_snapshot_free(snapshot);
+    return result;
+}
+
+/* Returns how many instructions from index on cannot be kept */
+static Double cannot_keep(const TraceFilter *filter, const Windows *windows, size_t *next,
+                          Double index) {
+    if (index < filter->start) {
+        return filter->start - index;
+    }
+    if (index >= filter->end) {
+        return EMULATOR_FOREVER;
+    }
+    if (filter->ecalls) {
+        while (*next < windows->count && windows->windows[*next].last < index) {
+            (*next)++;
+        }
+        if (*next == windows->count) {
+            return EMULATOR_FOREVER;
+        }
+        if (index < windows->windows[*next].first) {
+            return windows->windows[*next].first - index;
+        }
+    }
+    if (filter->low != 0 || filter->high != (Double)1 << 32) {
+        return 0;
+    }
+    return (filter->every - (index - filter->start) % filter->every) % filter->every;
+}
+
+int trace_filter_run(TraceFilter *filter, TraceSink *sink, Emulator *emulator, Double budget,
+                     void (*poll)(void *opaque), void *opaque) {
+    Processor *hart = &emulator->harts[0];
+    Double started = hart->instret;
+    EmulatorStatus status = EMULATOR_RUNNING;
+    Windows windows = {NULL, 0, 0, 0};
+    size_t next = 0;
+
+    if (filter->ecalls && find_ecalls(filter, emulator, budget, &windows) != 0) {
+        free(windows.windows);
+        return -1;
+    }
+
+    while (status == EMULATOR_RUNNING && hart->instret - started < budget) {
+        Double left = budget - (hart->instret - started);
+        Double skip = cannot_keep(filter, &windows, &next, hart->instret);
+        if (skip > 0) {
+            status = emulator_run(emulator, skip < left ? skip : left, NULL);
+        } else {
+            Register pc = hart->PC;
+            status = emulator_run(emulator, 1, NULL);
+            if (status == EMULATOR_RUNNING && pc >= filter->low && pc < filter->high &&
+                (hart->instret - 1 - filter->start) % filter->every == 0) {
+                trace_step(sink, hart->instret - 1, pc, hart->R);
+            }
+        }
+        if (poll != NULL) {
+            poll(opaque);
+        }
+    }
+
+    // an ecall near the end keeps the steps after it in the next run
+    if (windows.kept_until > hart->instret) {
+        filter->kept_until = windows.kept_until;
+    }
+    free(windows.windows);
+    return status;
+}
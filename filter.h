@@ -0,0 +1,39 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "types.h"
+#include "emulator.h"
+#include "trace.h"
+
+/* Which steps of a run a trace keeps: a step must pass every test that is
+   set. Steps are numbered by the hart's instret before they retire. */
+typedef struct {
+    Double start, end;          /* indices in [start, end) */
+    Double every;               /* every Nth from start */
+    Double low, high;           /* PCs in [low, high) */
+    int ecalls;                 /* only steps within around of an ecall */
+    Double around;
+    Word registers;             /* the registers each kept step shows */
+    Double kept_until;          /* the steps before it follow an ecall already run */
+} TraceFilter;
+
+/* Sets a filter that keeps every step, with every register */
+void trace_filter_init(TraceFilter *);
+
+/* Returns whether the filter leaves any step out */
+int trace_filter_active(const TraceFilter *);
+
+/* Runs hart 0 of a single-hart machine for up to budget instructions and
+   writes the steps that pass the filter to sink. Only those steps are run
+   one at a time; the stretches between them run at full speed. After each
+   stretch, poll is called with opaque unless it is NULL.
+
+   With ecalls set, the run is first made at full speed from a snapshot
+   (see snapshot.h), with guest output dropped, to find where the ecalls
+   are, and then made again for real. So the memory must not be watched.
+   Returns the status the machine stopped with, or -1 if it cannot be
+   snapshotted; then nothing has run. */
+int trace_filter_run(TraceFilter *, TraceSink *, Emulator *, Double budget,
+                     void (*poll)(void *opaque), void *opaque);
+
+#endif
@@ -0,0 +1,592 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "types.h"
+#include "utils.h"
+#include "riscv.h"
+#include "emulator.h"
+#include "gdb.h"
+
+/* Largest packet either side sends, as advertised to GDB in hex */
+#define PACKET_SIZE 0x4000
+
+#define MAX_BREAKPOINTS 256
+
+/* Instructions a continue runs between checks for Ctrl-C */
+#define CONTINUE_SLICE (1 << 20)
+
+#define EBREAK 0x00100073
+#define C_EBREAK 0x9002
+
+typedef struct {
+    Address address;
+    int length;                 /* 2 for a 16-bit parcel, else 4 */
+    Byte original[4];           /* the instruction the ebreak replaced */
+} Breakpoint;
+
+typedef struct {
+    int fd;
+    Emulator *emulator;
+    int acknowledge;            /* cleared by QStartNoAckMode */
+    Byte input[4096];
+    size_t input_start, input_end;
+    Breakpoint breakpoints[MAX_BREAKPOINTS];
+    int nbreakpoints;
+} Session;
+
+static const char *register_names[33] = {
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "fp", "s1", "a0",
+    "a1", "a2", "a3", "a4", "a5", "a6", "a7", "s2", "s3", "s4", "s5",
+    "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6", "pc",
+};
+
+/* Returns the next byte from GDB, or -1 once it has gone */
+static int receive(Session *session) {
+    while (session->input_start == session->input_end) {
+        ssize_t length = recv(session->fd, session->input, sizeof(session->input), 0);
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            return -1;
+        }
+        session->input_start = 0;
+        session->input_end = length;
+    }
+    return session->input[session->input_start++];
+}
+
+/* Consumes a Ctrl-C if GDB has sent one, without waiting */
+static int interrupted(Session *session) {
+    if (session->input_start == session->input_end) {
+        ssize_t length = recv(session->fd, session->input, sizeof(session->input), MSG_DONTWAIT);
+        if (length <= 0) {
+            return 0;
+        }
+        session->input_start = 0;
+        session->input_end = length;
+    }
+    if (session->input[session->input_start] == 0x03) {
+        session->input_start++;
+        return 1;
+    }
+    return 0;
+}
+
+static int send_all(int fd, const char *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        bytes += sent;
+        length -= sent;
+    }
+    return 0;
+}
+
+static int hex_value(int c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/* Reads a packet into packet, acknowledging it unless that is off.
+   Returns its length, or -1 once GDB has gone. */
+static int read_packet(Session *session, char *packet) {
+    for (;;) {
+        int c, length = 0;
+        Byte sum = 0;
+
+        // acks, and Ctrl-C while the machine is stopped, need no answer
+        do {
+            c = receive(session);
+        } while (c >= 0 && c != '$');
+        while ((c = receive(session)) >= 0 && c != '#') {
+            if (length < PACKET_SIZE) {
+                packet[length++] = c;
+            }
+            sum += c;
+        }
+        int high = receive(session), low = receive(session);
+        if (c < 0 || low < 0) {
+            return -1;
+        }
+        packet[length] = '\0';
+        if (!session->acknowledge) {
+            return length;
+        }
+        if (hex_value(high) * 16 + hex_value(low) == sum) {
+            return send_all(session->fd, "+", 1) == 0 ? length : -1;
+        }
+        if (send_all(session->fd, "-", 1) != 0) {
+            return -1;
+        }
+    }
+}
+
+/* Sends a packet and, unless acks are off, resends it until GDB has it */
+static int send_packet(Session *session, const char *data) {
+    static char frame[PACKET_SIZE + 4];
+    size_t length = strlen(data);
+    Byte sum = 0;
+
+    frame[0] = '$';
+    memcpy(frame + 1, data, length);
+    for (size_t i = 0; i < length; i++) {
+        sum += (Byte)data[i];
+    }
+    snprintf(frame + 1 + length, 4, "#%02x", sum);
+    for (;;) {
+        if (send_all(session->fd, frame, length + 4) != 0) {
+            return -1;
+        }
+        int c = session->acknowledge ? receive(session) : '+';
+        while (c >= 0 && c != '+' && c != '-') {
+            c = receive(session);
+        }
+        if (c != '-') {
+            return c < 0 ? -1 : 0;
+        }
+    }
+}
+
+/* Parses hex digits at *text, leaving *text after them */
+static Word parse_hex(const char **text) {
+    Word value = 0;
+    while (hex_value(**text) >= 0) {
+        value = value << 4 | hex_value(**text);
+        (*text)++;
+    }
+    return value;
+}
+
+/* Registers travel as target-order (little-endian) hex */
+static void format_word(char *out, Word value) {
+    for (int i = 0; i < 4; i++) {
+        sprintf(out + 2 * i, "%02x", (value >> (8 * i)) & 0xFF);
+    }
+}
+
+static int parse_word(const char *text, Word *value) {
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        int high = hex_value(text[2 * i]), low = high < 0 ? -1 : hex_value(text[2 * i + 1]);
+        if (low < 0) {
+            return -1;
+        }
+        *value |= (Word)(high * 16 + low) << (8 * i);
+    }
+    return 0;
+}
+
+static Breakpoint *find_breakpoint(Session *session, Address address) {
+    for (int i = 0; i < session->nbreakpoints; i++) {
+        if (session->breakpoints[i].address == address) {
+            return &session->breakpoints[i];
+        }
+    }
+    return NULL;
+}
+
+static void arm(Emulator *emulator, const Breakpoint *breakpoint) {
+    if (breakpoint->length == 2) {
+        store(emulator->memory, breakpoint->address, LENGTH_HALF_WORD, C_EBREAK);
+    } else {
+        store(emulator->memory, breakpoint->address, LENGTH_WORD, EBREAK);
+    }
+}
+
+static void disarm(Emulator *emulator, const Breakpoint *breakpoint) {
+    memcpy(emulator->memory + breakpoint->address, breakpoint->original, breakpoint->length);
+}
+
+static int insert_breakpoint(Session *session, Address address) {
+    Emulator *emulator = session->emulator;
+    if (find_breakpoint(session, address) != NULL) {
+        return 0;
+    }
+    if (session->nbreakpoints == MAX_BREAKPOINTS || address % 2 != 0 ||
+        address > MEMORY_SPACE - 4) {
+        return -1;
+    }
+    Breakpoint *breakpoint = &session->breakpoints[session->nbreakpoints++];
+    breakpoint->address = address;
+    breakpoint->length =
+        is_compressed(load(emulator->memory, address, LENGTH_HALF_WORD), emulator->compressed)
+            ? 2
+            : 4;
+    memcpy(breakpoint->original, emulator->memory + address, breakpoint->length);
+    arm(emulator, breakpoint);
+    return 0;
+}
+
+static void remove_breakpoint(Session *session, Address address) {
+    Breakpoint *breakpoint = find_breakpoint(session, address);
+    if (breakpoint != NULL) {
+        disarm(session->emulator, breakpoint);
+        *breakpoint = session->breakpoints[--session->nbreakpoints];
+    }
+}
+
+/* Guest memory as GDB sees it: with the instructions under breakpoints */
+static Byte *memory_byte(Session *session, Address address) {
+    for (int i = 0; i < session->nbreakpoints; i++) {
+        Breakpoint *breakpoint = &session->breakpoints[i];
+        if (address - breakpoint->address < (Address)breakpoint->length) {
+            return &breakpoint->original[address - breakpoint->address];
+        }
+    }
+    return &session->emulator->memory[address];
+}
+
+/* Runs one instruction; at a breakpoint, the one the ebreak replaced */
+static EmulatorStatus step(Session *session) {
+    Emulator *emulator = session->emulator;
+    Breakpoint *breakpoint = find_breakpoint(session, emulator->harts[0].PC);
+    if (breakpoint != NULL) {
+        disarm(emulator, breakpoint);
+    }
+    EmulatorStatus status = emulator_run(emulator, 1, NULL);
+    if (breakpoint != NULL) {
+        arm(emulator, breakpoint);
+    }
+    return status;
+}
+
+/* An ebreak in the guest's own code, not one of GDB's, stops the machine
+   on it, where running it again would only stop there again. Moves the
+   PC past it; returns whether there was one. */
+static int skip_guest_ebreak(Session *session) {
+    Emulator *emulator = session->emulator;
+    Processor *hart = &emulator->harts[0];
+    Word bits = load(emulator->memory, hart->PC, LENGTH_WORD);
+
+    if (hart->status != EMULATOR_BREAKPOINT || find_breakpoint(session, hart->PC) != NULL) {
+        return 0;
+    }
+    if (bits == EBREAK) {
+        hart->PC += 4;
+    } else if (emulator->compressed && (bits & 0xFFFF) == C_EBREAK) {
+        hart->PC += 2;
+    } else {
+        return 0;
+    }
+    hart->status = EMULATOR_RUNNING;
+    return 1;
+}
+
+/* Runs until the guest stops, reaches a breakpoint or GDB sends Ctrl-C.
+   Breakpoints cost nothing until they are hit: the ebreak stops the run. */
+static int resume(Session *session) {
+    EmulatorStatus status = step(session);
+    int stopped = 0;
+    while (status == EMULATOR_RUNNING && !(stopped = interrupted(session))) {
+        status = emulator_run(session->emulator, CONTINUE_SLICE, NULL);
+    }
+    return stopped;
+}
+
+/* Tells GDB why the machine stopped */
+static int report(Session *session, int stopped) {
+    switch (session->emulator->harts[0].status) {
+        case EMULATOR_EXITED:
+            return send_packet(session, "W00");
+        case EMULATOR_INVALID_INSTRUCTION:
+        case EMULATOR_ILLEGAL_ECALL:
+            return send_packet(session, "S04");
+        case EMULATOR_INVALID_ADDRESS:
+            return send_packet(session, "S0b");
+        default:
+            return send_packet(session, stopped ? "S02" : "S05");
+    }
+}
+
+/* The register layout GDB reads with qXfer:features:read */
+static void describe_target(char *xml, size_t size) {
+    int length = snprintf(xml, size,
+                          "<?xml version=\"1.0\"?><!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+                          "<target version=\"1.0\"><architecture>riscv:rv32</architecture>"
+                          "<feature name=\"org.gnu.gdb.riscv.cpu\">");
+    for (int i = 0; i < 33; i++) {
+        const char *type = i == 1 || i == 32 ? "code_ptr" : i == 2 ? "data_ptr" : "int";
+        length += snprintf(xml + length, size - length,
+                           "<reg name=\"%s\" bitsize=\"32\" type=\"%s\" regnum=\"%d\"/>",
+                           register_names[i], type, i);
+    }
+    snprintf(xml + length, size - length, "</feature></target>");
+}
+
+static int read_features(Session *session, const char *packet, char *reply) {
+    static const char prefix[] = "qXfer:features:read:target.xml:";
+    static char xml[4096];
+    const char *arguments = packet + strlen(prefix);
+    if (strncmp(packet, prefix, strlen(prefix)) != 0) {
+        return send_packet(session, "E00");
+    }
+    describe_target(xml, sizeof(xml));
+    size_t offset = parse_hex(&arguments);
+    arguments += *arguments == ',';
+    size_t length = parse_hex(&arguments), total = strlen(xml);
+    if (length > PACKET_SIZE - 2) {
+        length = PACKET_SIZE - 2;
+    }
+    if (offset >= total) {
+        return send_packet(session, "l");
+    }
+    if (length > total - offset) {
+        length = total - offset;
+    }
+    reply[0] = offset + length < total ? 'm' : 'l';
+    memcpy(reply + 1, xml + offset, length);
+    reply[length + 1] = '\0';
+    return send_packet(session, reply);
+}
+
+static int query(Session *session, const char *packet, char *reply) {
+    if (strncmp(packet, "qSupported", 10) == 0) {
+        snprintf(reply, PACKET_SIZE, "PacketSize=%x;QStartNoAckMode+;qXfer:features:read+",
+                 PACKET_SIZE);
+        return send_packet(session, reply);
+    }
+    if (strncmp(packet, "qXfer:features:read:", 20) == 0) {
+        return read_features(session, packet, reply);
+    }
+    if (strcmp(packet, "QStartNoAckMode") == 0) {
+        int result = send_packet(session, "OK");
+        session->acknowledge = 0;
+        return result;
+    }
+    if (strcmp(packet, "qAttached") == 0) {
+        return send_packet(session, "1");
+    }
+    if (strcmp(packet, "qC") == 0) {
+        return send_packet(session, "QC1");
+    }
+    if (strcmp(packet, "qfThreadInfo") == 0) {
+        return send_packet(session, "m1");
+    }
+    if (strcmp(packet, "qsThreadInfo") == 0) {
+        return send_packet(session, "l");
+    }
+    return send_packet(session, "");
+}
+
+/* Reads or writes memory: "m ADDR,LENGTH" and "M ADDR,LENGTH:BYTES" */
+static int access_memory(Session *session, const char *packet, char *reply) {
+    const char *text = packet + 1;
+    Address address = parse_hex(&text);
+    Word length = *text == ',' ? (text++, parse_hex(&text)) : 0;
+
+    if (address > MEMORY_SPACE || length > MEMORY_SPACE - address ||
+        length > (PACKET_SIZE - 1) / 2) {
+        return send_packet(session, "E01");
+    }
+    if (packet[0] == 'm') {
+        for (Word i = 0; i < length; i++) {
+            sprintf(reply + 2 * i, "%02x", *memory_byte(session, address + i));
+        }
+        reply[2 * length] = '\0';
+        return send_packet(session, reply);
+    }
+    if (*text++ != ':') {
+        return send_packet(session, "E01");
+    }
+    for (Word i = 0; i < length; i++) {
+        int high = hex_value(text[2 * i]), low = high < 0 ? -1 : hex_value(text[2 * i + 1]);
+        if (low < 0) {
+            return send_packet(session, "E01");
+        }
+        *memory_byte(session, address + i) = high * 16 + low;
+    }
+    return send_packet(session, "OK");
+}
+
+/* Answers one packet. Returns 1 if the session should end, 0 to go on,
+   or -1 if GDB has gone. */
+static int handle(Session *session, const char *packet, char *reply, int *detached) {
+    Processor *processor = &session->emulator->harts[0];
+    const char *text = packet + 1;
+    Word value;
+    Register *target;
+
+    switch (packet[0]) {
+        case '?':
+            return report(session, 0);
+        case 'g':
+            for (int i = 0; i < 33; i++) {
+                format_word(reply + 8 * i, i < 32 ? processor->R[i] : processor->PC);
+            }
+            return send_packet(session, reply);
+        case 'G':
+            if (strlen(text) < 33 * 8) {
+                return send_packet(session, "E01");
+            }
+            for (int i = 0; i < 33; i++) {
+                if (parse_word(text + 8 * i, &value) == 0) {
+                    *(i < 32 ? &processor->R[i] : &processor->PC) = value;
+                }
+            }
+            processor->R[0] = 0;
+            return send_packet(session, "OK");
+        case 'p':
+            value = parse_hex(&text);
+            if (value > 32) {
+                // a register this machine does not have
+                return send_packet(session, "xxxxxxxx");
+            }
+            format_word(reply, value < 32 ? processor->R[value] : processor->PC);
+            return send_packet(session, reply);
+        case 'P':
+            value = parse_hex(&text);
+            target = value < 32 ? &processor->R[value] : value == 32 ? &processor->PC : NULL;
+            if (target == NULL || *text++ != '=' || parse_word(text, target) != 0) {
+                return send_packet(session, "E01");
+            }
+            processor->R[0] = 0;
+            return send_packet(session, "OK");
+        case 'm':
+        case 'M':
+            return access_memory(session, packet, reply);
+        case 'c':
+        case 's':
+            if (*text != '\0') {
+                processor->PC = parse_hex(&text);
+            } else if (skip_guest_ebreak(session) && packet[0] == 's') {
+                // stepping over the guest's ebreak is the step
+                return report(session, 0);
+            }
+            if (packet[0] == 's') {
+                step(session);
+                return report(session, 0);
+            }
+            return report(session, resume(session));
+        case 'Z':
+        case 'z':
+            if (packet[1] != '0' || packet[2] != ',') {
+                // only software breakpoints
+                return send_packet(session, "");
+            }
+            text = packet + 3;
+            value = parse_hex(&text);
+            if (packet[0] == 'z') {
+                remove_breakpoint(session, value);
+            } else if (insert_breakpoint(session, value) != 0) {
+                return send_packet(session, "E01");
+            }
+            return send_packet(session, "OK");
+        case 'H':
+        case 'T':
+            return send_packet(session, "OK");
+        case 'D':
+            *detached = 1;
+            return send_packet(session, "OK") == 0 ? 1 : -1;
+        case 'k':
+            return 1;
+        case 'q':
+        case 'Q':
+            return query(session, packet, reply);
+        default:
+            return send_packet(session, "");
+    }
+}
+
+/* Accepts one connection on address and returns it, or -1 */
+static int accept_debugger(const char *address) {
+    char *end;
+    long port = strtol(address, &end, 10);
+    int listener, unix_socket = *address == '\0' || *end != '\0';
+
+    if (unix_socket) {
+        struct sockaddr_un local = {.sun_family = AF_UNIX};
+        if (strlen(address) >= sizeof(local.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", address);
+            return -1;
+        }
+        strcpy(local.sun_path, address);
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(address);
+        if (listener >= 0 && bind(listener, (struct sockaddr *)&local, sizeof(local)) != 0) {
+            close(listener);
+            listener = -1;
+        }
+    } else {
+        struct sockaddr_in local = {.sin_family = AF_INET,
+                                    .sin_port = htons(port),
+                                    .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+        int on = 1;
+        listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listener >= 0 &&
+            (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+             bind(listener, (struct sockaddr *)&local, sizeof(local)) != 0)) {
+            close(listener);
+            listener = -1;
+        }
+    }
+    if (listener < 0 || listen(listener, 1) != 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", address, strerror(errno));
+        if (listener >= 0) {
+            close(listener);
+        }
+        return -1;
+    }
+
+    fprintf(stderr, "Waiting for gdb on %s\n", address);
+    int fd;
+    do {
+        fd = accept(listener, NULL, NULL);
+    } while (fd < 0 && errno == EINTR);
+    close(listener);
+    if (unix_socket) {
+        unlink(address);
+    }
+    if (fd >= 0 && !unix_socket) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
+
+int gdb_serve(Emulator *emulator, const char *address) {
+    static char packet[PACKET_SIZE + 1], reply[PACKET_SIZE + 1];
+    Session *session = calloc(1, sizeof(Session));
+    int detached = 0, result = 0;
+
+    if (session == NULL) {
+        return -1;
+    }
+    session->emulator = emulator;
+    session->acknowledge = 1;
+    session->fd = accept_debugger(address);
+    if (session->fd < 0) {
+        free(session);
+        return -1;
+    }
+    while (result == 0 && read_packet(session, packet) >= 0) {
+        result = handle(session, packet, reply, &detached);
+    }
+    // leave the program as it was loaded
+    while (session->nbreakpoints > 0) {
+        remove_breakpoint(session, session->breakpoints[0].address);
+    }
+    close(session->fd);
+    free(session);
+    return detached;
+}
@@ -0,0 +1,27 @@
+#ifndef GDB_H
+#define GDB_H
+
+#include "emulator.h"
+
+/* riscv --gdb serves a single-hart machine to one GDB over the Remote
+   Serial Protocol, on 127.0.0.1:PORT when the address is a number and on
+   a Unix domain socket otherwise:
+
+       gdb -ex 'target remote :1234'
+
+   GDB can read and write the registers and memory, step, continue, stop
+   a run with Ctrl-C and set software breakpoints. A breakpoint replaces
+   its instruction in guest memory with an ebreak (c.ebreak over a 16-bit
+   parcel), so code runs at full speed until it reaches one, and GDB sees
+   the original bytes when it reads memory. An ebreak in the guest's own
+   code stops the machine on it as well; the next step or continue moves
+   past it, and a step stops right after it. Under GDB the machine runs
+   until the guest stops, as with -e; guest output goes to stdout. */
+
+/* Waits for GDB at address and serves it until it kills the machine,
+   detaches or disconnects. Afterwards the reason the machine last stopped
+   is in harts[0].status. Returns 1 if GDB detached, so the run should
+   carry on, 0 otherwise, or -1 if the socket cannot be set up. */
+int gdb_serve(Emulator *, const char *address);
+
+#endif
@@ -0,0 +1,73 @@
+# Plays Remote Serial Protocol packets to riscv --gdb, the way GDB would,
+# and prints each packet with the stub's reply.
+#
+# usage: python3 gdb_client.py SOCKET < packets
+#
+# SOCKET is a Unix socket path, or a TCP port on 127.0.0.1. Each line of
+# the input is one packet without its $ and checksum; blank lines and
+# lines starting with # are skipped.
+
+import socket
+import sys
+import time
+
+
+def connect(address):
+    for attempt in range(500):
+        try:
+            if address.isdigit():
+                return socket.create_connection(("127.0.0.1", int(address)))
+            sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            sock.connect(address)
+            return sock
+        except OSError:
+            time.sleep(0.01)
+    sys.exit("cannot connect to " + address)
+
+
+def receive(sock, count=1):
+    data = b""
+    while len(data) < count:
+        chunk = sock.recv(count - len(data))
+        if not chunk:
+            sys.exit("the stub hung up")
+        data += chunk
+    return data
+
+
+def read_reply(sock):
+    # skip the ack of our packet
+    while receive(sock) != b"$":
+        pass
+    reply = b""
+    while True:
+        c = receive(sock)
+        if c == b"#":
+            break
+        reply += c
+    checksum = int(receive(sock, 2), 16)
+    if checksum != sum(reply) % 256:
+        sys.exit("bad checksum on " + reply.decode())
+    sock.sendall(b"+")
+    return reply.decode()
+
+
+def main():
+    sock = connect(sys.argv[1])
+    for line in sys.stdin:
+        packet = line.strip()
+        if not packet or packet.startswith("#"):
+            continue
+        frame = "$%s#%02x" % (packet, sum(packet.encode()) % 256)
+        sock.sendall(frame.encode())
+        print("> " + packet)
+        if packet in ("k", "D"):
+            if packet == "D":
+                print("< " + read_reply(sock))
+            break
+        print("< " + read_reply(sock))
+    sock.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,397 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "types.h"
+#include "riscv.h"
+#include "emulator.h"
+#include "lockstep.h"
+#include "pool.h"
+#include "memory.h"
+#include "jobs.h"
+#include "trace.h"
+#include "filter.h"
+
+void init_args(Processor *processor, char *arg) {
+  char *next;
+  char *token = strtok_r(arg, ",", &next);
+  int i = 0;
+  while (token != NULL) {
+    processor->R[i + 10] = (int32_t)strtol(token, NULL, 16);
+    token = strtok_r(NULL, ",", &next);
+    i++;
+  }
+}
+
+void print_registers(FILE *out, const Register *R) {
+  char text[TRACE_TEXT_SIZE];
+  fwrite(text, 1, trace_format_registers(text, R), out);
+}
+
+int print_status(FILE *out, Emulator *emulator, EmulatorStatus status) {
+  switch (status) {
+  case EMULATOR_EXITED:
+    fprintf(out, "exiting the simulator\n");
+    return 0;
+  case EMULATOR_INVALID_INSTRUCTION:
+    fprintf(out, "Invalid Instruction: 0x%08x\n", emulator->fault);
+    return -1;
+  case EMULATOR_ILLEGAL_ECALL:
+    fprintf(out, "Illegal ecall number %d\n", emulator->harts[0].R[10]);
+    return -1;
+  case EMULATOR_BREAKPOINT:
+    fprintf(out, "Breakpoint at 0x%08x\n", emulator->harts[0].PC);
+    return -1;
+  case EMULATOR_INVALID_ADDRESS:
+    fprintf(out, "Invalid address 0x%08x\n", emulator->fault_address);
+    return -1;
+  default:
+    return 0;
+  }
+}
+
+void write_stream(void *opaque, const char *text, size_t length) {
+  fwrite(text, 1, length, opaque);
+}
+
+int read_job(FILE *jobs, Job *job) {
+  char line[512];
+  while (fgets(line, sizeof(line), jobs) != NULL) {
+    int fields = sscanf(line, "%255s %255s", job->args, job->data_file);
+    if (fields < 1 || job->args[0] == '#') {
+      continue;
+    }
+    if (fields < 2) {
+      job->data_file[0] = '\0';
+    }
+    return 1;
+  }
+  return 0;
+}
+
+int setup_job(Emulator *emulator, Job *job) {
+  if (job->data_file[0] != '\0' &&
+      emulator_load(emulator, job->data_file, emulator->harts[0].R[3], 0) < 0) {
+    return -1;
+  }
+  if (strcmp(job->args, "-") != 0) {
+    init_args(&emulator->harts[0], job->args);
+  }
+  return 0;
+}
+
+Emulator *start_job(const Emulator *image, Job *job) {
+  Emulator *emulator = emulator_clone(image);
+  if (emulator != NULL && setup_job(emulator, job) != 0) {
+    emulator_destroy(emulator);
+    return NULL;
+  }
+  return emulator;
+}
+
+int run_job(Emulator *emulator, Double budget, FILE *out, int print) {
+  EmulatorStatus status = EMULATOR_RUNNING;
+
+  emulator->output = write_stream;
+  emulator->output_opaque = out;
+  if (print) {
+    for (Double simins = 0; simins < budget && status == EMULATOR_RUNNING; simins++) {
+      status = emulator_run(emulator, 1, NULL);
+      if (status == EMULATOR_RUNNING) {
+        print_registers(out, emulator->harts[0].R);
+      }
+    }
+  } else {
+    status = emulator_run(emulator, budget, NULL);
+  }
+  return print_status(out, emulator, status);
+}
+
+/* Returns the instruction at address and sets *length to its size in
+ * bytes; past the end of guest memory it reads as 0, four bytes long */
+static uint32_t fetch(const Emulator *emulator, Address address, int *length) {
+  uint32_t instruction_bits = 0;
+  *length = emulator_fetch(emulator, address, &instruction_bits);
+  if (*length == 0) {
+    *length = 4;
+  }
+  return instruction_bits;
+}
+
+int show_instruction(const Emulator *emulator, Address address) {
+  int length;
+  uint32_t instruction_bits = fetch(emulator, address, &length);
+  printf("%08x: ", address);
+  decode_instruction(instruction_bits, emulator->compressed);
+  return length;
+}
+
+void disassemble(const Emulator *emulator, Address address, int numins) {
+  for (int i = 0; i < numins; i++) {
+    address += show_instruction(emulator, address);
+  }
+}
+
+static void trace_stream(void *opaque, int lane, const Register *R) {
+  FILE **out = opaque;
+  print_registers(out[lane], R);
+}
+
+/* Runs one batch of jobs in lockstep; each lane collects its own output,
+ * which is printed once the batch is done */
+static int run_lanes(Emulator **lanes, int nlanes, Double budget, int print) {
+  Lockstep lockstep;
+  FILE *out[LOCKSTEP_LANES];
+  char *text[LOCKSTEP_LANES];
+  size_t size[LOCKSTEP_LANES];
+  int result = 0;
+
+  for (int lane = 0; lane < nlanes; lane++) {
+    out[lane] = open_memstream(&text[lane], &size[lane]);
+    lanes[lane]->output = write_stream;
+    lanes[lane]->output_opaque = out[lane];
+  }
+  lockstep_init(&lockstep, lanes, nlanes);
+  if (print) {
+    lockstep.trace = trace_stream;
+    lockstep.trace_opaque = out;
+  }
+  lockstep_run(&lockstep, budget);
+
+  for (int lane = 0; lane < nlanes; lane++) {
+    if (print_status(out[lane], lanes[lane], lockstep.status[lane]) != 0) {
+      result = -1;
+    }
+    fclose(out[lane]);
+    fwrite(text[lane], 1, size[lane], stdout);
+    free(text[lane]);
+    emulator_destroy(lanes[lane]);
+  }
+  return result;
+}
+
+int run_batch(const Emulator *image, const char *jobfile, Double budget, int print) {
+  FILE *jobs = fopen(jobfile, "r");
+  Emulator *lanes[LOCKSTEP_LANES];
+  Job job;
+  int nlanes = 0, result = 0;
+
+  if (jobs == NULL) {
+    fprintf(stderr, "Cannot read %s\n", jobfile);
+    return -1;
+  }
+  while (read_job(jobs, &job)) {
+    Emulator *emulator = start_job(image, &job);
+    if (emulator == NULL) {
+      fprintf(stderr, "Cannot start job %s %s\n", job.args, job.data_file);
+      result = -1;
+      continue;
+    }
+    lanes[nlanes++] = emulator;
+    if (nlanes == LOCKSTEP_LANES) {
+      result |= run_lanes(lanes, nlanes, budget, print);
+      nlanes = 0;
+    }
+  }
+  if (nlanes > 0) {
+    result |= run_lanes(lanes, nlanes, budget, print);
+  }
+  fclose(jobs);
+  return result;
+}
+
+/* A job of a sweep and what it printed */
+typedef struct {
+  Job job;
+  char *text;
+  size_t size;
+  int result;
+} SweepRun;
+
+typedef struct {
+  const Emulator *image;
+  SweepRun *runs;
+  Double budget;
+  int print;
+} Sweep;
+
+static void run_sweep_job(void *opaque, int index) {
+  Sweep *sweep = opaque;
+  SweepRun *run = &sweep->runs[index];
+  FILE *out = open_memstream(&run->text, &run->size);
+  Emulator *emulator = start_job(sweep->image, &run->job);
+
+  if (emulator == NULL) {
+    fprintf(out, "Cannot start job %s %s\n", run->job.args, run->job.data_file);
+    run->result = -1;
+  } else {
+    run->result = run_job(emulator, sweep->budget, out, sweep->print);
+    emulator_destroy(emulator);
+  }
+  fclose(out);
+}
+
+int run_sweep(const Emulator *image, const char *jobfile, Double budget, int print) {
+  FILE *jobs = fopen(jobfile, "r");
+  Sweep sweep = {image, NULL, budget, print};
+  int njobs = 0, capacity = 0, result = 0;
+  Job job;
+
+  if (jobs == NULL) {
+    fprintf(stderr, "Cannot read %s\n", jobfile);
+    return -1;
+  }
+  while (read_job(jobs, &job)) {
+    if (njobs == capacity) {
+      capacity = capacity ? capacity * 2 : 64;
+      sweep.runs = realloc(sweep.runs, capacity * sizeof(SweepRun));
+      assert(sweep.runs != NULL);
+    }
+    sweep.runs[njobs++].job = job;
+  }
+  fclose(jobs);
+
+  pool_run(njobs, sysconf(_SC_NPROCESSORS_ONLN), run_sweep_job, &sweep);
+  for (int i = 0; i < njobs; i++) {
+    fwrite(sweep.runs[i].text, 1, sweep.runs[i].size, stdout);
+    free(sweep.runs[i].text);
+    result |= sweep.runs[i].result;
+  }
+  free(sweep.runs);
+  return result;
+}
+
+int run_fork_server(Emulator *emulator, Double budget, int print) {
+  Job job;
+  int result = 0, status;
+
+  while (read_job(stdin, &job)) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+      perror("fork");
+      return -1;
+    }
+    if (child == 0) {
+      int code = -1;
+      if (setup_job(emulator, &job) != 0) {
+        fprintf(stderr, "Cannot start job %s %s\n", job.args, job.data_file);
+      } else {
+        code = run_job(emulator, budget, stdout, print);
+      }
+      fflush(stdout);
+      _exit(code & 0xff);
+    }
+    if (waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+int arm_watches(WatchList *list, Emulator *emulator, char **requests, int nrequests) {
+  if (nrequests > 0 && emulator->nharts > 1) {
+    fprintf(stderr, "Watchpoints need a single hart\n");
+    return -1;
+  }
+  for (list->count = 0; list->count < nrequests; list->count++) {
+    MemoryWatch *watch = &list->watches[list->count];
+    unsigned address, length = 4;
+    if (sscanf(requests[list->count], "%x,%x", &address, &length) < 1 ||
+        memory_watch(watch, emulator->memory, address, length) != 0) {
+      fprintf(stderr, "Cannot watch %s\n", requests[list->count]);
+      return -1;
+    }
+    watch->hart = &emulator->harts[0];
+    watch->stop = &emulator->stop;
+  }
+  return 0;
+}
+
+int report_watches(WatchList *list, FILE *out) {
+  int hits = 0;
+  for (int i = 0; i < list->count; i++) {
+    MemoryWatch *watch = &list->watches[i];
+    if (watch->hit) {
+      fprintf(out, "watchpoint 0x%08x: pc %08x, 0x%0*x -> 0x%0*x\n", watch->address, watch->pc,
+              2 * watch->length, watch->old, 2 * watch->length, watch->value);
+      watch->hit = 0;
+      hits++;
+    }
+  }
+  return hits;
+}
+
+void disarm_watches(WatchList *list) {
+  while (list->count > 0) {
+    memory_unwatch(&list->watches[--list->count]);
+  }
+}
+
+/* Where the run prints what is not guest output */
+static FILE *run_output(Run *run) {
+  return run->trace != NULL ? trace_output(run->trace) : stdout;
+}
+
+static int run_diverged(Run *run) {
+  return run->trace != NULL && trace_diverged(run->trace);
+}
+
+static void poll_watches(void *opaque) {
+  Run *run = opaque;
+  report_watches(&run->watches, run_output(run));
+}
+
+EmulatorStatus run_step(Run *run, int prompt, int print) {
+  Emulator *emulator = run->emulator;
+  Processor *processor = &emulator->harts[0];
+  Register pc = processor->PC;
+
+  /* interactive-mode prompt */
+  if (prompt) {
+    if (prompt == 1) {
+      printf("simulator paused,enter to continue...");
+      while (getchar() != '\n')
+        ;
+    }
+    show_instruction(emulator, processor->PC);
+  }
+
+  EmulatorStatus status = emulator_run(emulator, 1, NULL);
+  if (status != EMULATOR_RUNNING) {
+    return status;
+  }
+
+  // print trace
+  if (print && run->trace != NULL) {
+    trace_step(run->trace, processor->instret - 1, pc, processor->R);
+  } else if (print) {
+    print_registers(stdout, processor->R);
+  }
+  return status;
+}
+
+EmulatorStatus run_for(Run *run, Double budget, int prompt, int print) {
+  EmulatorStatus status = EMULATOR_RUNNING;
+  if (print && run->trace != NULL && trace_filter_active(&run->filter)) {
+    status = trace_filter_run(&run->filter, run->trace, run->emulator, budget, poll_watches, run);
+    if ((int)status < 0) {
+      fprintf(stderr, "Cannot snapshot the machine to find the ecalls\n");
+    }
+  } else if (prompt || print) {
+    for (Double simins = 0; simins < budget && status == EMULATOR_RUNNING && !run_diverged(run);
+         simins++) {
+      status = run_step(run, prompt, print);
+      poll_watches(run);
+    }
+  } else {
+    // a watch that catches a write stops the run so it can be reported
+    Double retired = 0;
+    do {
+      status = emulator_run(run->emulator, budget - retired, &retired);
+    } while (report_watches(&run->watches, run_output(run)) > 0 && status == EMULATOR_RUNNING &&
+             retired < budget);
+  }
+  return status;
+}
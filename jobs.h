@@ -0,0 +1,105 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdio.h>
+#include "types.h"
+#include "emulator.h"
+#include "memory.h"
+#include "trace.h"
+#include "filter.h"
+
+/* What the front ends share: running a loaded program the way riscv does
+   and printing what it printed, for one run or for many jobs */
+
+/* Prints the instruction at address as -d does; returns its length */
+int show_instruction(const Emulator *emulator, Address address);
+
+/* Prints numins instructions from address the way the loader laid them out */
+void disassemble(const Emulator *emulator, Address address, int numins);
+
+/* One run of a program: the -a values ("-" for none) and optionally a data
+   file for -s. In a job file, each line holds one job. */
+typedef struct {
+  char args[256];
+  char data_file[256];
+} Job;
+
+/* Sets a0, a1, ... from comma-separated hex values; arg is overwritten */
+void init_args(Processor *processor, char *arg);
+
+/* Prints the 32 registers as the trace does */
+void print_registers(FILE *out, const Register *R);
+
+/* Prints why a run ended, and returns the simulator's exit code */
+int print_status(FILE *out, Emulator *emulator, EmulatorStatus status);
+
+/* EmulatorOutput that writes to the FILE * in opaque */
+void write_stream(void *opaque, const char *text, size_t length);
+
+/* Returns 1 with the next job of a job file, skipping blank lines and
+   # comments, or 0 at the end of the file */
+int read_job(FILE *jobs, Job *job);
+
+/* Loads the job's data and arguments into a fresh clone of the image.
+   Returns 0, or -1 if the data file cannot be read. */
+int setup_job(Emulator *emulator, Job *job);
+
+/* Creates the job's machine as a copy-on-write clone of the loaded image,
+   or returns NULL */
+Emulator *start_job(const Emulator *image, Job *job);
+
+/* Runs hart 0 for up to budget instructions, sending guest output to out
+   and, with print set, the registers after each instruction. Ends with
+   the status line and returns the exit code. */
+int run_job(Emulator *emulator, Double budget, FILE *out, int print);
+
+/* -b: runs each job of the file on a clone of the image, in lockstep
+   batches. Each job prints exactly what its own run would. */
+int run_batch(const Emulator *image, const char *jobfile, Double budget, int print);
+
+/* --sweep: runs every job of the file on a clone of the image, spread over
+   a thread per CPU, then prints what each printed in file order */
+int run_sweep(const Emulator *image, const char *jobfile, Double budget, int print);
+
+/* --fork-server: runs each job line read from stdin in a child that
+   shares the machine copy-on-write, one after another */
+int run_fork_server(Emulator *emulator, Double budget, int print);
+
+/* --watch: guest addresses whose writes are reported as the run goes */
+#define MAX_WATCHES 8
+
+typedef struct {
+  MemoryWatch watches[MAX_WATCHES];
+  int count;
+} WatchList;
+
+/* Arms watches, given as ADDRESS[,LENGTH] in hex, on a single-hart
+   machine. Returns 0, or -1 after saying what went wrong. */
+int arm_watches(WatchList *, Emulator *emulator, char **requests, int nrequests);
+
+/* Prints the writes the watches caught; returns how many there were */
+int report_watches(WatchList *, FILE *out);
+
+void disarm_watches(WatchList *);
+
+/* One machine run step by step where it has to be: with print set, each
+   step the filter keeps goes to the trace, or to stdout as registers if
+   there is none, and the watches are reported as the run goes */
+typedef struct {
+  Emulator *emulator;
+  TraceSink *trace;
+  TraceFilter filter;
+  WatchList watches;
+} Run;
+
+/* Runs one instruction of hart 0. With prompt set it is shown first, and
+   with prompt 1 only once enter is pressed. */
+EmulatorStatus run_step(Run *, int prompt, int print);
+
+/* Runs for up to budget instructions, one at a time only when it has to
+   prompt or print the steps, and stops early once an expecting trace has
+   diverged. Returns the status the machine stopped with, or -1 if the
+   filters could not run it. */
+EmulatorStatus run_for(Run *, Double budget, int prompt, int print);
+
+#endif
@@ -0,0 +1,356 @@
+#include <string.h>
+#include "types.h"
+#include "utils.h"
+#include "riscv.h"
+#include "vector.h"
+#include "lockstep.h"
+
+static Word get_lane(Lockstep *lockstep, int reg, int lane) {
+    return vector_get_element(lockstep->R[reg], lane, LENGTH_WORD);
+}
+
+static void set_lane(Lockstep *lockstep, int reg, int lane, Word value) {
+    vector_set_element(lockstep->R[reg], lane, LENGTH_WORD, value);
+}
+
+static void broadcast(Byte *reg, Word value) {
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        vector_set_element(reg, lane, LENGTH_WORD, value);
+    }
+}
+
+/* Turns a compare mask into 0/1 in every lane, as slt writes it */
+static void set_flags(Byte *reg, Word mask) {
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        vector_set_element(reg, lane, LENGTH_WORD, (mask >> lane) & 1);
+    }
+}
+
+/* Moves a lane's registers from the lockstep file into its hart and back */
+static void scatter_lane(Lockstep *lockstep, int lane, Register PC) {
+    Processor *processor = &lockstep->lanes[lane]->harts[0];
+    for (int reg = 0; reg < 32; reg++) {
+        processor->R[reg] = get_lane(lockstep, reg, lane);
+    }
+    processor->PC = PC;
+}
+
+static void gather_lane(Lockstep *lockstep, int lane) {
+    Processor *processor = &lockstep->lanes[lane]->harts[0];
+    for (int reg = 0; reg < 32; reg++) {
+        set_lane(lockstep, reg, lane, processor->R[reg]);
+    }
+}
+
+void lockstep_init(Lockstep *lockstep, Emulator **lanes, int nlanes) {
+    memset(lockstep, 0, sizeof(Lockstep));
+    lockstep->nlanes = nlanes;
+    lockstep->PC = lanes[0]->harts[0].PC;
+    for (int lane = 0; lane < nlanes; lane++) {
+        lockstep->lanes[lane] = lanes[lane];
+        lockstep->status[lane] = EMULATOR_RUNNING;
+        gather_lane(lockstep, lane);
+        if (lanes[lane]->harts[0].PC == lockstep->PC) {
+            lockstep->active |= 1U << lane;
+        }
+    }
+}
+
+/* Returns whether the word at rs1 + offset is in memory on every active lane */
+static int lanes_in_memory(Lockstep *lockstep, int rs1, Word offset) {
+    for (int lane = 0; lane < lockstep->nlanes; lane++) {
+        if ((lockstep->active & (1U << lane)) &&
+            get_lane(lockstep, rs1, lane) + offset > MEMORY_SPACE - LENGTH_WORD) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Executes instructions that have a lockstep form across every lane and
+   sets each lane's next PC. Returns 0 for anything else. */
+static int execute_lanes(Lockstep *lockstep, Instruction instruction, int length,
+                         Register *next) {
+    Byte immediate[VLENB];
+    VectorOp op;
+    Word mask = 0;
+    int lane;
+
+    for (lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        next[lane] = lockstep->PC + length;
+    }
+    switch (instruction.opcode) {
+        case 0x33:
+            if (instruction.rtype.funct3 == 0x2) {
+                // SLT
+                set_flags(lockstep->R[instruction.rtype.rd],
+                    vector_compare(VECTOR_LT, LENGTH_WORD, lockstep->R[instruction.rtype.rs1],
+                        lockstep->R[instruction.rtype.rs2]));
+                return 1;
+            }
+            switch (instruction.rtype.funct3 << 8 | instruction.rtype.funct7) {
+                case 0x000:
+                    op = VECTOR_ADD;
+                    break;
+                case 0x020:
+                    op = VECTOR_SUB;
+                    break;
+                case 0x001:
+                    op = VECTOR_MUL;
+                    break;
+                case 0x400:
+                    op = VECTOR_XOR;
+                    break;
+                case 0x600:
+                    op = VECTOR_OR;
+                    break;
+                case 0x700:
+                    op = VECTOR_AND;
+                    break;
+                default:
+                    return 0;
+            }
+            vector_binary(op, LENGTH_WORD, lockstep->R[instruction.rtype.rd],
+                lockstep->R[instruction.rtype.rs1], lockstep->R[instruction.rtype.rs2]);
+            return 1;
+        case 0x13:
+            broadcast(immediate, sign_extend_number(instruction.itype.imm, 12));
+            switch (instruction.itype.funct3) {
+                case 0x0:
+                    op = VECTOR_ADD;
+                    break;
+                case 0x2:
+                    // SLTI
+                    set_flags(lockstep->R[instruction.itype.rd],
+                        vector_compare(VECTOR_LT, LENGTH_WORD,
+                            lockstep->R[instruction.itype.rs1], immediate));
+                    return 1;
+                case 0x4:
+                    op = VECTOR_XOR;
+                    break;
+                case 0x6:
+                    op = VECTOR_OR;
+                    break;
+                case 0x7:
+                    op = VECTOR_AND;
+                    break;
+                default:
+                    return 0;
+            }
+            vector_binary(op, LENGTH_WORD, lockstep->R[instruction.itype.rd],
+                lockstep->R[instruction.itype.rs1], immediate);
+            return 1;
+        case 0x37:
+            broadcast(lockstep->R[instruction.utype.rd],
+                ((sWord)sign_extend_number(instruction.utype.imm, 20)) << 12);
+            return 1;
+        case 0x17:
+            broadcast(lockstep->R[instruction.utype.rd], lockstep->PC +
+                (((sWord)sign_extend_number(instruction.utype.imm, 20)) << 12));
+            return 1;
+        case 0x6F:
+            broadcast(lockstep->R[instruction.ujtype.rd], lockstep->PC + length);
+            for (lane = 0; lane < LOCKSTEP_LANES; lane++) {
+                next[lane] = lockstep->PC + get_jump_offset(instruction);
+            }
+            return 1;
+        case 0x63:
+            if (instruction.sbtype.funct3 > 0x1) {
+                return 0;
+            }
+            // BEQ and BNE; lanes that disagree split up afterwards
+            mask = vector_compare(instruction.sbtype.funct3 ? VECTOR_NE : VECTOR_EQ, LENGTH_WORD,
+                lockstep->R[instruction.sbtype.rs1], lockstep->R[instruction.sbtype.rs2]);
+            for (lane = 0; lane < LOCKSTEP_LANES; lane++) {
+                if (mask & (1U << lane)) {
+                    next[lane] = lockstep->PC + get_branch_offset(instruction);
+                }
+            }
+            return 1;
+        case 0x03:
+            if (instruction.itype.funct3 != 0x2) {
+                return 0;
+            }
+            // LW, from each lane's own memory; lanes go one by one if any is out of range
+            if (!lanes_in_memory(lockstep, instruction.itype.rs1,
+                                 sign_extend_number(instruction.itype.imm, 12))) {
+                return 0;
+            }
+            for (lane = 0; lane < lockstep->nlanes; lane++) {
+                if (lockstep->active & (1U << lane)) {
+                    Address address = get_lane(lockstep, instruction.itype.rs1, lane) +
+                        sign_extend_number(instruction.itype.imm, 12);
+                    set_lane(lockstep, instruction.itype.rd, lane,
+                        load(lockstep->lanes[lane]->memory, address, LENGTH_WORD));
+                }
+            }
+            return 1;
+        case 0x23:
+            if (instruction.stype.funct3 != 0x2) {
+                return 0;
+            }
+            // SW
+            if (!lanes_in_memory(lockstep, instruction.stype.rs1,
+                                 get_store_offset(instruction))) {
+                return 0;
+            }
+            for (lane = 0; lane < lockstep->nlanes; lane++) {
+                if (lockstep->active & (1U << lane)) {
+                    Address address = get_lane(lockstep, instruction.stype.rs1, lane) +
+                        get_store_offset(instruction);
+                    store(lockstep->lanes[lane]->memory, address, LENGTH_WORD,
+                        get_lane(lockstep, instruction.stype.rs2, lane));
+                }
+            }
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* Runs one instruction on each active lane's own hart */
+static void execute_each_lane(Lockstep *lockstep, uint32_t instruction_bits, Register *next) {
+    for (int lane = 0; lane < lockstep->nlanes; lane++) {
+        if (!(lockstep->active & (1U << lane))) {
+            continue;
+        }
+        Emulator *emulator = lockstep->lanes[lane];
+        scatter_lane(lockstep, lane, lockstep->PC);
+        EmulatorStatus status =
+            execute_instruction(instruction_bits, &emulator->harts[0], emulator);
+        if (status != EMULATOR_RUNNING) {
+            lockstep->status[lane] = status;
+            emulator->fault = instruction_bits;
+            emulator->fault_address = emulator->harts[0].fault_address;
+            lockstep->active &= ~(1U << lane);
+            continue;
+        }
+        emulator->harts[0].R[0] = 0;
+        gather_lane(lockstep, lane);
+        next[lane] = emulator->harts[0].PC;
+    }
+}
+
+/* Stops every active lane on a PC outside guest memory */
+static void stop_lanes(Lockstep *lockstep) {
+    for (int lane = 0; lane < lockstep->nlanes; lane++) {
+        if (lockstep->active & (1U << lane)) {
+            Emulator *emulator = lockstep->lanes[lane];
+            scatter_lane(lockstep, lane, lockstep->PC);
+            lockstep->status[lane] = EMULATOR_INVALID_ADDRESS;
+            emulator->fault = 0;
+            emulator->fault_address = lockstep->PC;
+        }
+    }
+    lockstep->active = 0;
+}
+
+static void trace_lane(Lockstep *lockstep, int lane) {
+    Register R[32];
+    for (int reg = 0; reg < 32; reg++) {
+        R[reg] = get_lane(lockstep, reg, lane);
+    }
+    lockstep->trace(lockstep->trace_opaque, lane, R);
+}
+
+/* Keeps the largest group of lanes that agree on the next PC in lockstep
+   and returns the mask of the others */
+static Word regroup(Lockstep *lockstep, const Register *next) {
+    int best = -1, best_size = 0;
+    for (int lane = 0; lane < lockstep->nlanes; lane++) {
+        int size = 0;
+        if (!(lockstep->active & (1U << lane))) {
+            continue;
+        }
+        for (int other = 0; other < lockstep->nlanes; other++) {
+            size += (lockstep->active & (1U << other)) && next[other] == next[lane];
+        }
+        if (size > best_size) {
+            best = lane;
+            best_size = size;
+        }
+    }
+    Word leaving = 0;
+    if (best < 0) {
+        return 0;
+    }
+    for (int lane = 0; lane < lockstep->nlanes; lane++) {
+        if ((lockstep->active & (1U << lane)) && next[lane] != next[best]) {
+            leaving |= 1U << lane;
+            scatter_lane(lockstep, lane, next[lane]);
+        }
+    }
+    lockstep->active &= ~leaving;
+    lockstep->PC = next[best];
+    return leaving;
+}
+
+/* Finishes a lane that left the group on its own */
+static EmulatorStatus run_lane(Lockstep *lockstep, int lane, Double budget) {
+    Emulator *emulator = lockstep->lanes[lane];
+    EmulatorStatus status = EMULATOR_RUNNING;
+
+    if (lockstep->trace == NULL) {
+        return emulator_run(emulator, budget, NULL);
+    }
+    for (Double count = 0; count < budget && status == EMULATOR_RUNNING; count++) {
+        status = emulator_run(emulator, 1, NULL);
+        if (status == EMULATOR_RUNNING) {
+            lockstep->trace(lockstep->trace_opaque, lane, emulator->harts[0].R);
+        }
+    }
+    return status;
+}
+
+void lockstep_run(Lockstep *lockstep, Double budget) {
+    Word all = (1U << lockstep->nlanes) - 1;
+    Word detached = all & ~lockstep->active;
+    Double start[LOCKSTEP_LANES];
+    Register next[LOCKSTEP_LANES];
+    int lane;
+
+    for (lane = 0; lane < lockstep->nlanes; lane++) {
+        start[lane] = lockstep->lanes[lane]->harts[0].instret;
+    }
+    for (Double count = 0; count < budget && lockstep->active; count++) {
+        Emulator *leader = lockstep->lanes[__builtin_ctz(lockstep->active)];
+        int length = 4;
+
+        /* fetch once for the group, from the leader's copy of the program */
+        uint32_t instruction_bits = 0;
+        if (emulator_fetch(leader, lockstep->PC, &instruction_bits) == 0) {
+            stop_lanes(lockstep);
+            break;
+        }
+        uint32_t expanded = instruction_bits;
+        if (is_compressed(instruction_bits, leader->compressed)) {
+            expanded = expand_compressed(instruction_bits & 0xFFFF, NULL);
+            length = 2;
+        }
+
+        if (expanded == 0 ||
+            !execute_lanes(lockstep, parse_instruction(expanded), length, next)) {
+            execute_each_lane(lockstep, instruction_bits, next);
+        }
+        memset(lockstep->R[0], 0, VLENB);
+
+        for (lane = 0; lane < lockstep->nlanes; lane++) {
+            if (lockstep->active & (1U << lane)) {
+                lockstep->lanes[lane]->harts[0].instret++;
+                if (lockstep->trace != NULL) {
+                    trace_lane(lockstep, lane);
+                }
+            }
+        }
+        detached |= regroup(lockstep, next);
+    }
+
+    for (lane = 0; lane < lockstep->nlanes; lane++) {
+        if (lockstep->active & (1U << lane)) {
+            scatter_lane(lockstep, lane, lockstep->PC);
+        } else if (detached & (1U << lane)) {
+            Double retired = lockstep->lanes[lane]->harts[0].instret - start[lane];
+            lockstep->status[lane] = run_lane(lockstep, lane, budget - retired);
+        }
+    }
+}
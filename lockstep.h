@@ -0,0 +1,42 @@
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "types.h"
+#include "emulator.h"
+
+/* One lane per 32-bit element of a vector register, so a whole register
+   file row fits the AVX2 kernels in vector.c */
+#define LOCKSTEP_LANES (VLENB / LENGTH_WORD)
+
+/* Called after every instruction a lane retires, with its registers */
+typedef void (*LockstepTrace)(void *opaque, int lane, const Register *R);
+
+/* Runs the same program in up to LOCKSTEP_LANES emulators (hart 0 of each)
+   at once. While the lanes agree on the PC, each instruction is decoded
+   once and the common ALU, branch and word memory instructions execute
+   across all lanes in structure-of-arrays form. Other instructions run
+   lane by lane through execute_instruction(). A lane whose PC leaves the
+   group finishes on its own with emulator_run(). The lanes must not write
+   to their code. */
+typedef struct {
+    Emulator *lanes[LOCKSTEP_LANES];
+    int nlanes;
+    EmulatorStatus status[LOCKSTEP_LANES];
+    LockstepTrace trace;        /* optional */
+    void *trace_opaque;
+
+    /* state of the lanes still in lockstep: register i of lane n is
+       element n of R[i] */
+    Byte R[32][VLENB];
+    Register PC;
+    Word active;                /* mask of lanes in lockstep */
+} Lockstep;
+
+/* Starts a batch over nlanes emulators that are loaded and ready to run */
+void lockstep_init(Lockstep *, Emulator **lanes, int nlanes);
+
+/* Runs every lane until it stops or retires budget instructions; each
+   lane's result is left in status[] */
+void lockstep_run(Lockstep *, Double budget);
+
+#endif
@@ -0,0 +1,411 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "types.h"
+#include "memory.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HOST_X86 1
+#define TRAP_FLAG 0x100
+#endif
+
+/* The trackers the fault handler searches; a slot is claimed with a CAS
+   so tracking can start on any thread */
+#define MAX_TRACKERS 4096
+
+static MemoryTracker *trackers[MAX_TRACKERS];
+static struct sigaction previous;
+static pthread_once_t handler_once = PTHREAD_ONCE_INIT;
+
+/* Watches are claimed the same way. A thread that is single-stepping a
+   store into a watched page keeps the page in stepping. */
+#define MAX_WATCHES 64
+
+static MemoryWatch *watches[MAX_WATCHES];
+static struct sigaction previous_trap;
+static pthread_once_t trap_once = PTHREAD_ONCE_INIT;
+static __thread Byte *stepping;
+
+static Byte *page_of(const void *address) {
+    return (Byte *)((uintptr_t)address & ~(uintptr_t)(PAGE_SIZE - 1));
+}
+
+/* Hands a signal that is not ours to the handler installed before */
+static void pass_on(int signal, siginfo_t *info, void *context, struct sigaction *before) {
+    if (before->sa_flags & SA_SIGINFO) {
+        before->sa_sigaction(signal, info, context);
+    } else if (before->sa_handler != SIG_DFL && before->sa_handler != SIG_IGN) {
+        before->sa_handler(signal);
+    } else {
+        // let it happen again unhandled
+        sigaction(signal, before, NULL);
+    }
+}
+
+#ifdef HOST_X86
+static greg_t *flags_register(void *context) {
+    return &((ucontext_t *)context)->uc_mcontext.gregs[REG_EFL];
+}
+
+/* A write to a watched page: lets the store through for one instruction */
+static int step_watched_store(const void *address, void *context) {
+    Byte *page = page_of(address);
+    for (int slot = 0; slot < MAX_WATCHES; slot++) {
+        MemoryWatch *watch = __atomic_load_n(&watches[slot], __ATOMIC_ACQUIRE);
+        if (watch != NULL && page_of(watch->memory + watch->address) == page) {
+            if (mprotect(page, PAGE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+                return 0;
+            }
+            stepping = page;
+            *flags_register(context) |= TRAP_FLAG;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* The store has run: records the watches it changed and protects the page */
+static void handle_trap(int signal, siginfo_t *info, void *context) {
+    Byte *page = stepping;
+    if (page == NULL) {
+        pass_on(signal, info, context, &previous_trap);
+        return;
+    }
+    stepping = NULL;
+    *flags_register(context) &= ~TRAP_FLAG;
+
+    for (int slot = 0; slot < MAX_WATCHES; slot++) {
+        MemoryWatch *watch = __atomic_load_n(&watches[slot], __ATOMIC_ACQUIRE);
+        Word value = 0;
+        if (watch == NULL || page_of(watch->memory + watch->address) != page) {
+            continue;
+        }
+        memcpy(&value, watch->memory + watch->address, watch->length);
+        if (value == watch->value) {
+            continue;
+        }
+        if (!watch->hit) {
+            watch->old = watch->value;
+            watch->pc = watch->hart != NULL ? watch->hart->PC : 0;
+            watch->hit = 1;
+        }
+        watch->value = value;
+        if (watch->stop != NULL) {
+            __atomic_store_n(watch->stop, 1, __ATOMIC_RELAXED);
+        }
+    }
+    mprotect(page, PAGE_SIZE, PROT_READ);
+}
+
+static void install_trap_handler(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handle_trap;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGTRAP, &action, &previous_trap);
+}
+#endif
+
+static MemoryTracker *find_tracker(const Byte *address) {
+    for (int slot = 0; slot < MAX_TRACKERS; slot++) {
+        MemoryTracker *tracker = __atomic_load_n(&trackers[slot], __ATOMIC_ACQUIRE);
+        if (tracker != NULL && address >= tracker->memory &&
+            address < tracker->memory + MEMORY_SPACE) {
+            return tracker;
+        }
+    }
+    return NULL;
+}
+
+static void handle_fault(int signal, siginfo_t *info, void *context) {
+#ifdef HOST_X86
+    if (step_watched_store(info->si_addr, context)) {
+        return;
+    }
+#endif
+    MemoryTracker *tracker = find_tracker(info->si_addr);
+    if (tracker != NULL) {
+        unsigned page = ((Byte *)info->si_addr - tracker->memory) >> PAGE_SHIFT;
+        __atomic_fetch_or(&tracker->dirty[page / 64], 1ULL << (page % 64), __ATOMIC_RELAXED);
+        if (mprotect(tracker->memory + ((size_t)page << PAGE_SHIFT), PAGE_SIZE,
+                     PROT_READ | PROT_WRITE) == 0) {
+            return;
+        }
+    }
+
+    pass_on(signal, info, context, &previous);
+}
+
+static void install_handler(void) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = handle_fault;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &previous);
+}
+
+int memory_track(MemoryTracker *tracker, Byte *memory) {
+    if (sysconf(_SC_PAGESIZE) != PAGE_SIZE) {
+        return -1;
+    }
+    pthread_once(&handler_once, install_handler);
+
+    memset(tracker, 0, sizeof(MemoryTracker));
+    tracker->memory = memory;
+    for (tracker->slot = 0; tracker->slot < MAX_TRACKERS; tracker->slot++) {
+        MemoryTracker *empty = NULL;
+        if (__atomic_compare_exchange_n(&trackers[tracker->slot], &empty, tracker, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (tracker->slot == MAX_TRACKERS) {
+        return -1;
+    }
+    if (mprotect(memory, MEMORY_SPACE, PROT_READ) != 0) {
+        __atomic_store_n(&trackers[tracker->slot], NULL, __ATOMIC_RELEASE);
+        return -1;
+    }
+    return 0;
+}
+
+void memory_untrack(MemoryTracker *tracker) {
+    mprotect(tracker->memory, MEMORY_SPACE, PROT_READ | PROT_WRITE);
+    __atomic_store_n(&trackers[tracker->slot], NULL, __ATOMIC_RELEASE);
+}
+
+int memory_is_dirty(const MemoryTracker *tracker, unsigned page) {
+    return (__atomic_load_n(&tracker->dirty[page / 64], __ATOMIC_RELAXED) >> (page % 64)) & 1;
+}
+
+int memory_clean(MemoryTracker *tracker) {
+    int result = 0;
+    for (unsigned word = 0; word < MEMORY_PAGES / 64; word++) {
+        uint64_t dirty = __atomic_exchange_n(&tracker->dirty[word], 0, __ATOMIC_RELAXED);
+        while (dirty != 0) {
+            unsigned page = word * 64 + __builtin_ctzll(dirty);
+            dirty &= dirty - 1;
+            if (mprotect(tracker->memory + ((size_t)page << PAGE_SHIFT), PAGE_SIZE,
+                         PROT_READ) != 0) {
+                result = -1;
+            }
+        }
+    }
+    return result;
+}
+
+int memory_watch(MemoryWatch *watch, Byte *memory, Address address, Word length) {
+    memset(watch, 0, sizeof(MemoryWatch));
+#ifdef HOST_X86
+    if ((length != 1 && length != 2 && length != 4) || address > MEMORY_SPACE - length ||
+        (address >> PAGE_SHIFT) != ((address + length - 1) >> PAGE_SHIFT) ||
+        sysconf(_SC_PAGESIZE) != PAGE_SIZE) {
+        return -1;
+    }
+    pthread_once(&handler_once, install_handler);
+    pthread_once(&trap_once, install_trap_handler);
+
+    watch->memory = memory;
+    watch->address = address;
+    watch->length = length;
+    memcpy(&watch->value, memory + address, length);
+    for (watch->slot = 0; watch->slot < MAX_WATCHES; watch->slot++) {
+        MemoryWatch *empty = NULL;
+        if (__atomic_compare_exchange_n(&watches[watch->slot], &empty, watch, 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if (watch->slot == MAX_WATCHES) {
+        return -1;
+    }
+    if (mprotect(page_of(memory + address), PAGE_SIZE, PROT_READ) != 0) {
+        __atomic_store_n(&watches[watch->slot], NULL, __ATOMIC_RELEASE);
+        return -1;
+    }
+    return 0;
+#else
+    (void)memory;
+    (void)address;
+    (void)length;
+    return -1;
+#endif
+}
+
+void memory_unwatch(MemoryWatch *watch) {
+    Byte *page = page_of(watch->memory + watch->address);
+    __atomic_store_n(&watches[watch->slot], NULL, __ATOMIC_RELEASE);
+    for (int slot = 0; slot < MAX_WATCHES; slot++) {
+        MemoryWatch *other = __atomic_load_n(&watches[slot], __ATOMIC_ACQUIRE);
+        if (other != NULL && page_of(other->memory + other->address) == page) {
+            return;
+        }
+    }
+    mprotect(page, PAGE_SIZE, PROT_READ | PROT_WRITE);
+}
+
+/* Free regions; a thread's own come first. A region keeps whatever it
+   was mapping, with its written pages already dropped, and is turned into
+   what the next user needs when it is taken. */
+#define THREAD_REGIONS 4
+#define POOL_REGIONS 64
+
+typedef struct {
+    Byte *memory;
+    int mapped;
+} Region;
+
+typedef struct {
+    Region regions[THREAD_REGIONS];
+    int count;
+} RegionCache;
+
+static __thread RegionCache region_cache;
+static Region pool_regions[POOL_REGIONS];
+static int pool_count;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t cache_key;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static Double pool_allocations, pool_hits, pool_recycled;
+
+/* Keeps a region in the global list, or unmaps it if that is full */
+static void pool_put(Region region) {
+    pthread_mutex_lock(&pool_lock);
+    if (pool_count < POOL_REGIONS) {
+        pool_regions[pool_count++] = region;
+        region.memory = NULL;
+    }
+    pthread_mutex_unlock(&pool_lock);
+    if (region.memory != NULL) {
+        munmap(region.memory, MEMORY_SPACE);
+    }
+}
+
+/* Hands a thread's regions to the pool when the thread exits */
+static void release_regions(void *unused) {
+    (void)unused;
+    while (region_cache.count > 0) {
+        pool_put(region_cache.regions[--region_cache.count]);
+    }
+}
+
+static void create_cache_key(void) {
+    pthread_key_create(&cache_key, release_regions);
+}
+
+static Region take_region(void) {
+    Region region = {NULL, 0};
+
+    __atomic_fetch_add(&pool_allocations, 1, __ATOMIC_RELAXED);
+    if (region_cache.count > 0) {
+        region = region_cache.regions[--region_cache.count];
+    } else {
+        pthread_mutex_lock(&pool_lock);
+        if (pool_count > 0) {
+            region = pool_regions[--pool_count];
+        }
+        pthread_mutex_unlock(&pool_lock);
+    }
+    if (region.memory != NULL) {
+        __atomic_fetch_add(&pool_hits, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&pool_recycled, MEMORY_SPACE, __ATOMIC_RELAXED);
+    }
+    return region;
+}
+
+Byte *memory_alloc(void) {
+    Region region = take_region();
+    Byte *memory;
+
+    // a region that was mapping an image would read back the image
+    if (region.memory != NULL && region.mapped &&
+        mmap(region.memory, MEMORY_SPACE, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        munmap(region.memory, MEMORY_SPACE);
+        region.memory = NULL;
+    }
+    if (region.memory != NULL) {
+        return region.memory;
+    }
+    memory = mmap(NULL, MEMORY_SPACE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                  0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+Byte *memory_map(int image, off_t offset) {
+    Region region = take_region();
+    Byte *memory;
+
+    if (region.memory != NULL) {
+        if (memory_remap(region.memory, image, offset) == 0) {
+            return region.memory;
+        }
+        munmap(region.memory, MEMORY_SPACE);
+    }
+    memory = mmap(NULL, MEMORY_SPACE, PROT_READ | PROT_WRITE, MAP_PRIVATE, image, offset);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+int memory_remap(Byte *memory, int image, off_t offset) {
+    return mmap(memory, MEMORY_SPACE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, image,
+                offset) == MAP_FAILED
+               ? -1
+               : 0;
+}
+
+int memory_is_zero_page(const Byte *bytes) {
+    return bytes[0] == 0 && memcmp(bytes, bytes + 1, PAGE_SIZE - 1) == 0;
+}
+
+int memory_write_image(int file, const Byte *memory, off_t offset) {
+    if (ftruncate(file, offset + MEMORY_SPACE) != 0) {
+        return -1;
+    }
+    for (long page = 0; page < MEMORY_SPACE; page += PAGE_SIZE) {
+        if (!memory_is_zero_page(memory + page) &&
+            pwrite(file, memory + page, PAGE_SIZE, offset + page) != PAGE_SIZE) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void memory_free(Byte *memory, int mapped) {
+    Region region = {memory, mapped};
+
+    if (memory == NULL) {
+        return;
+    }
+    /* drop the written pages now rather than hold them while pooled; an
+     * anonymous region then reads as zero, one mapping an image reads the
+     * image again */
+    if (madvise(memory, MEMORY_SPACE, MADV_DONTNEED) != 0) {
+        munmap(memory, MEMORY_SPACE);
+        return;
+    }
+
+    pthread_once(&cache_once, create_cache_key);
+    if (region_cache.count < THREAD_REGIONS) {
+        region_cache.regions[region_cache.count++] = region;
+        pthread_setspecific(cache_key, &region_cache);
+        return;
+    }
+    pool_put(region);
+}
+
+void memory_pool_stats(MemoryPoolStats *stats) {
+    struct rusage usage;
+    stats->allocations = __atomic_load_n(&pool_allocations, __ATOMIC_RELAXED);
+    stats->hits = __atomic_load_n(&pool_hits, __ATOMIC_RELAXED);
+    stats->recycled = __atomic_load_n(&pool_recycled, __ATOMIC_RELAXED);
+    getrusage(RUSAGE_SELF, &usage);
+    stats->faults = usage.ru_minflt;
+}
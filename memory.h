@@ -0,0 +1,104 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "types.h"
+
+/* Guest memory is tracked in host pages */
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define MEMORY_PAGES (MEMORY_SPACE / PAGE_SIZE)
+
+/* Records which pages of a guest memory have been written. Tracked pages
+   are write-protected; the first write to one faults, and the SIGSEGV
+   handler marks it dirty and lets the write through. Faults elsewhere go
+   to whatever handler was installed before. */
+typedef struct {
+    Byte *memory;
+    uint64_t dirty[MEMORY_PAGES / 64];
+    int slot;
+} MemoryTracker;
+
+/* Starts tracking the MEMORY_SPACE bytes at memory, which must be page
+   aligned and mapped. Returns 0, or -1 if too many memories are tracked
+   or the host page size is not PAGE_SIZE. */
+int memory_track(MemoryTracker *, Byte *memory);
+
+/* Stops tracking and makes every page writable again */
+void memory_untrack(MemoryTracker *);
+
+/* Returns whether page has been written since it was last cleaned */
+int memory_is_dirty(const MemoryTracker *, unsigned page);
+
+/* Write-protects the dirty pages again and forgets that they were written */
+int memory_clean(MemoryTracker *);
+
+/* A data watchpoint on a byte, half word or word of a guest memory. The
+   host page holding it is write-protected, so writes to other pages cost
+   nothing. A write to the page faults, and the handler single-steps the
+   one host store through and protects the page again; only when that
+   store changed the watched bytes does the watch record a hit. Needs an
+   x86 host, which can single-step. A watched memory must not also be
+   tracked. */
+typedef struct {
+    Byte *memory;
+    Address address;
+    Word length;                /* 1, 2 or 4 bytes, in one page */
+    const Processor *hart;      /* optional: whose PC a hit records */
+    int *stop;                  /* optional: set on a hit */
+
+    /* the first write that changed the bytes since hit was cleared */
+    int hit;
+    Register pc;
+    Word old;
+    Word value;                 /* the watched bytes as last seen */
+    int slot;
+} MemoryWatch;
+
+/* Starts watching length bytes at address of the MEMORY_SPACE bytes at
+   memory. Returns 0, or -1 if the range is not valid, too many are
+   watched or the host cannot single-step. */
+int memory_watch(MemoryWatch *, Byte *memory, Address address, Word length);
+
+/* Stops watching; the page is writable again once no watch is left on it */
+void memory_unwatch(MemoryWatch *);
+
+/* Guest memories are MEMORY_SPACE regions recycled through a pool rather
+   than mapped and unmapped for every machine. A freed region gives its
+   written pages back with madvise(MADV_DONTNEED) instead of being cleared.
+   Each thread keeps a few free regions of its own and shares the rest
+   through a global list. */
+
+/* Returns a region that reads as zero, or NULL */
+Byte *memory_alloc(void);
+
+/* Returns a region holding a private copy-on-write mapping of the
+   MEMORY_SPACE bytes at offset in the image file, or NULL */
+Byte *memory_map(int image, off_t offset);
+
+/* Maps an image copy-on-write over a region, dropping what it held */
+int memory_remap(Byte *memory, int image, off_t offset);
+
+/* Returns a region to the pool; mapped is set if it maps an image */
+void memory_free(Byte *memory, int mapped);
+
+/* Returns whether the PAGE_SIZE bytes at bytes are all zero */
+int memory_is_zero_page(const Byte *bytes);
+
+/* Writes a guest memory into file at offset, a multiple of PAGE_SIZE, and
+   sizes the file to end with it. Zero pages are left as holes, which read
+   as zero. Returns 0, or -1 on failure. */
+int memory_write_image(int file, const Byte *memory, off_t offset);
+
+typedef struct {
+    Double allocations;         /* regions handed out */
+    Double hits;                /* of those, recycled from the pool */
+    Double recycled;            /* bytes handed out again from the pool */
+    Double faults;              /* minor page faults in the process */
+} MemoryPoolStats;
+
+void memory_pool_stats(MemoryPoolStats *);
+
+#endif
@@ -1,7 +1,9 @@
 #include <stdio.h> // for stderr
 #include <stdlib.h> // for exit()
+#include <string.h>
 #include "types.h"
 #include "utils.h"
+#include "custom.h"
 
 void print_rtype(char *, Instruction);
 void print_itype_except_load(char *, Instruction, int);
@@ -10,16 +12,29 @@ void print_store(char *, Instruction);
 void print_branch(char *, Instruction);
 void print_lui(Instruction);
 void print_jal(Instruction);
+void print_jalr(Instruction);
+void print_auipc(Instruction);
 void print_ecall(Instruction);
+void write_system(Instruction);
+void write_atomic(Instruction);
+void write_fence(Instruction);
 void write_rtype(Instruction);
 void write_itype_except_load(Instruction); 
 void write_load(Instruction);
 void write_store(Instruction);
 void write_branch(Instruction);
-void print_lsgt(char *, Instruction);
+void write_custom(Instruction);
+void write_compressed(Half);
+void write_vector(Instruction);
+void write_vector_memory(Instruction);
+void format_vtype(char *, Word);
 
 
-void decode_instruction(uint32_t instruction_bits) {
+void decode_instruction(uint32_t instruction_bits, int compressed) {
+    if (is_compressed(instruction_bits, compressed)) {
+        write_compressed(instruction_bits & 0xFFFF);
+        return;
+    }
     Instruction instruction = parse_instruction(instruction_bits);
     switch(instruction.opcode) {
         case 0x33:
@@ -40,14 +55,37 @@ void decode_instruction(uint32_t instruction_bits) {
         case 0x37:
             print_lui(instruction);
             break;
+        case 0x17:
+            print_auipc(instruction);
+            break;
         case 0x6F:
             print_jal(instruction);
             break;
+        case 0x67:
+            print_jalr(instruction);
+            break;
         case 0x73:
-            print_ecall(instruction);
+            write_system(instruction);
+            break;
+        case 0x2F:
+            write_atomic(instruction);
             break;
+        case 0x0F:
+            write_fence(instruction);
+            break;
+        case 0x0b:
         case 0x2a:
-            print_lsgt("lsgt", instruction);
+        case 0x2b:
+        case 0x5b:
+        case 0x7b:
+            write_custom(instruction);
+            break;
+        case 0x57:
+            write_vector(instruction);
+            break;
+        case 0x07:
+        case 0x27:
+            write_vector_memory(instruction);
             break;
         default: // undefined opcode
             handle_invalid_instruction(instruction);
@@ -244,6 +282,87 @@ void print_jal(Instruction instruction) {
     printf(JAL_FORMAT, instruction.ujtype.rd, offset);
 }
 
+void print_jalr(Instruction instruction) {
+    if (instruction.itype.funct3 != 0x0) {
+        handle_invalid_instruction(instruction);
+        return;
+    }
+    printf(JALR_FORMAT, instruction.itype.rd,
+        sign_extend_number(instruction.itype.imm, 12), instruction.itype.rs1);
+}
+
+void print_auipc(Instruction instruction) {
+    printf(AUIPC_FORMAT, instruction.utype.rd, instruction.utype.imm);
+}
+
+void write_system(Instruction instruction) {
+    static const char *names[8] = {
+        [0x1] = "csrrw", [0x2] = "csrrs", [0x3] = "csrrc",
+        [0x5] = "csrrwi", [0x6] = "csrrsi", [0x7] = "csrrci",
+    };
+    const char *csr = get_csr_name(instruction.itype.imm);
+
+    if (instruction.itype.funct3 == 0x0 && instruction.itype.rd == 0 &&
+        instruction.itype.rs1 == 0 && instruction.itype.imm <= 1) {
+        if (instruction.itype.imm == 0) {
+            print_ecall(instruction);
+        } else {
+            printf(EBREAK_FORMAT);
+        }
+    } else if (names[instruction.itype.funct3] == NULL || csr == NULL) {
+        handle_invalid_instruction(instruction);
+    } else if (instruction.itype.funct3 & 0x4) {
+        // the rs1 field holds a 5-bit unsigned immediate
+        printf(CSRI_FORMAT, names[instruction.itype.funct3], instruction.itype.rd,
+            csr, instruction.itype.rs1);
+    } else {
+        printf(CSR_FORMAT, names[instruction.itype.funct3], instruction.itype.rd,
+            csr, instruction.itype.rs1);
+    }
+}
+
+void write_atomic(Instruction instruction) {
+    const char *name = get_amo_name(instruction);
+    const char *ordering = get_amo_ordering(instruction);
+
+    if (name == NULL) {
+        handle_invalid_instruction(instruction);
+    } else if (instruction.atype.funct5 == 0x02) {
+        printf(LR_FORMAT, ordering, instruction.atype.rd, instruction.atype.rs1);
+    } else {
+        printf(AMO_FORMAT, name, ordering, instruction.atype.rd, instruction.atype.rs2,
+            instruction.atype.rs1);
+    }
+}
+
+/* Writes a fence predecessor or successor set, e.g. "rw" */
+static void format_fence_set(char *buffer, unsigned set) {
+    const char *flags = "iorw";
+    for (int bit = 3; bit >= 0; bit--) {
+        if (set & (1U << bit)) {
+            *buffer++ = flags[3 - bit];
+        }
+    }
+    if (set == 0) {
+        *buffer++ = '0';
+    }
+    *buffer = '\0';
+}
+
+void write_fence(Instruction instruction) {
+    char pred[5], succ[5];
+
+    if (instruction.itype.funct3 == 0x1) {
+        printf(FENCE_I_FORMAT);
+    } else if (instruction.itype.funct3 == 0x0 && (instruction.itype.imm >> 8) == 0) {
+        format_fence_set(pred, (instruction.itype.imm >> 4) & 0xF);
+        format_fence_set(succ, instruction.itype.imm & 0xF);
+        printf(FENCE_FORMAT, pred, succ);
+    } else {
+        handle_invalid_instruction(instruction);
+    }
+}
+
 void print_ecall(Instruction instruction) {
     /* YOUR CODE HERE */
     printf(ECALL_FORMAT);
@@ -284,7 +403,156 @@ void print_branch(char *name, Instruction instruction) {
     printf(BRANCH_FORMAT, name, instruction.sbtype.rs1, instruction.sbtype.rs2, offset);
 }
 
-void print_lsgt(char *name, Instruction instruction){
-    printf(RTYPE_FORMAT, name, instruction.rtype.rd, instruction.rtype.rs1,
-         instruction.rtype.rs2);
+void write_custom(Instruction instruction) {
+    const CustomInstruction *custom = find_custom_instruction(instruction);
+    if (custom == NULL) {
+        handle_invalid_instruction(instruction);
+    } else if (custom->disassemble != NULL) {
+        custom->disassemble(custom->name, instruction);
+    } else {
+        print_rtype((char *)custom->name, instruction);
+    }
+}
+
+/* Compressed instructions are disassembled from their 32-bit expansion, so
+   the operand fields come from the same decoders the full-size forms use */
+void write_compressed(Half instruction_bits) {
+    const char *name;
+    uint32_t expanded = expand_compressed(instruction_bits, &name);
+    Instruction instruction;
+    if (expanded == 0) {
+        instruction.bits = instruction_bits;
+        handle_invalid_instruction(instruction);
+        return;
+    }
+    instruction = parse_instruction(expanded);
+    switch (instruction.opcode) {
+        case 0x13:
+            if (strcmp(name, "c.nop") == 0) {
+                printf(CNOP_FORMAT);
+            } else if (strcmp(name, "c.addi4spn") == 0) {
+                printf(ITYPE_FORMAT, name, instruction.itype.rd,
+                    instruction.itype.rs1, instruction.itype.imm);
+            } else if (instruction.itype.funct3 == 0x1 ||
+                       instruction.itype.funct3 == 0x5) {
+                printf(CI_FORMAT, name, instruction.itype.rd,
+                    instruction.itype.imm & 0x1F);
+            } else {
+                printf(CI_FORMAT, name, instruction.itype.rd,
+                    sign_extend_number(instruction.itype.imm, 12));
+            }
+            break;
+        case 0x3:
+            print_load((char *)name, instruction);
+            break;
+        case 0x23:
+            print_store((char *)name, instruction);
+            break;
+        case 0x37:
+            printf(CI_FORMAT, name, instruction.utype.rd, instruction.utype.imm);
+            break;
+        case 0x33:
+            printf(CR_FORMAT, name, instruction.rtype.rd, instruction.rtype.rs2);
+            break;
+        case 0x63:
+            printf(CI_FORMAT, name, instruction.sbtype.rs1,
+                get_branch_offset(instruction));
+            break;
+        case 0x6F:
+            printf(CJ_FORMAT, name, get_jump_offset(instruction));
+            break;
+        case 0x67:
+            printf(CJR_FORMAT, name, instruction.itype.rs1);
+            break;
+        case 0x73:
+            printf(CEBREAK_FORMAT);
+            break;
+    }
+}
+
+void write_vector(Instruction instruction) {
+    char vtype[32];
+    const char *name;
+    const char *mask = instruction.varith.vm ? "" : ", v0.t";
+
+    if (instruction.varith.funct3 == 0x7) {
+        if ((instruction.bits >> 31) == 0) {
+            format_vtype(vtype, (instruction.bits >> 20) & 0x7FF);
+            printf(VSETVLI_FORMAT, instruction.varith.vd, instruction.varith.vs1, vtype);
+        } else if ((instruction.bits >> 30) == 0x3) {
+            format_vtype(vtype, (instruction.bits >> 20) & 0x3FF);
+            printf(VSETIVLI_FORMAT, instruction.varith.vd, instruction.varith.vs1, vtype);
+        } else if (instruction.varith.funct6 == 0x20 && !instruction.varith.vm) {
+            printf(VSETVL_FORMAT, instruction.varith.vd, instruction.varith.vs1,
+                instruction.varith.vs2);
+        } else {
+            handle_invalid_instruction(instruction);
+        }
+        return;
+    }
+
+    name = get_vector_name(instruction);
+    if (name == NULL) {
+        handle_invalid_instruction(instruction);
+        return;
+    }
+    if (instruction.varith.funct6 == 0x17 && instruction.varith.funct3 == 0x3) {
+        printf(VMV_V_FORMAT, name, instruction.varith.vd, "",
+            sign_extend_number(instruction.varith.vs1, 5));
+    } else if (instruction.varith.funct6 == 0x17) {
+        printf(VMV_V_FORMAT, name, instruction.varith.vd,
+            instruction.varith.funct3 == 0x0 ? "v" : "x", instruction.varith.vs1);
+    } else if (instruction.varith.funct6 == 0x10 && instruction.varith.funct3 == 0x2) {
+        printf(VMV_XS_FORMAT, name, instruction.varith.vd, instruction.varith.vs2);
+    } else if (instruction.varith.funct6 == 0x10) {
+        printf(VMV_SX_FORMAT, name, instruction.varith.vd, instruction.varith.vs1);
+    } else if (instruction.varith.funct3 == 0x3) {
+        printf(VI_FORMAT, name, instruction.varith.vd, instruction.varith.vs2,
+            sign_extend_number(instruction.varith.vs1, 5), mask);
+    } else if (instruction.varith.funct3 == 0x4 || instruction.varith.funct3 == 0x6) {
+        printf(VX_FORMAT, name, instruction.varith.vd, instruction.varith.vs2,
+            instruction.varith.vs1, mask);
+    } else {
+        printf(VV_FORMAT, name, instruction.varith.vd, instruction.varith.vs2,
+            instruction.varith.vs1, mask);
+    }
+}
+
+void write_vector_memory(Instruction instruction) {
+    int width = get_vector_width(instruction);
+    int store = instruction.opcode == 0x27;
+    const char *mask = instruction.vmem.vm ? "" : ", v0.t";
+
+    if (width == 0 || instruction.vmem.nf != 0 || instruction.vmem.mew != 0) {
+        handle_invalid_instruction(instruction);
+        return;
+    }
+    switch (instruction.vmem.mop) {
+        case 0x0:
+            if (instruction.vmem.rs2 != 0) {
+                handle_invalid_instruction(instruction);
+                break;
+            }
+            printf(VMEM_FORMAT, store ? "vse" : "vle", width * 8,
+                instruction.vmem.vd, instruction.vmem.rs1, mask);
+            break;
+        case 0x2:
+            printf(VMEM_STRIDED_FORMAT, store ? "vsse" : "vlse", width * 8,
+                instruction.vmem.vd, instruction.vmem.rs1, instruction.vmem.rs2, mask);
+            break;
+        default:
+            handle_invalid_instruction(instruction);
+            break;
+    }
+}
+
+/* Formats a vtype immediate the way assemblers write it, e.g. "e32, m1, ta, ma" */
+void format_vtype(char *buffer, Word vtype) {
+    static const char *lmul[8] = {"m1", "m2", "m4", "m8", NULL, "mf8", "mf4", "mf2"};
+    if ((vtype >> 8) != 0 || ((vtype >> 3) & 0x7) > 3 || lmul[vtype & 0x7] == NULL) {
+        sprintf(buffer, "%u", vtype);
+        return;
+    }
+    sprintf(buffer, "e%d, %s, %s, %s", 8 << ((vtype >> 3) & 0x7), lmul[vtype & 0x7],
+        (vtype & 0x40) ? "ta" : "tu", (vtype & 0x80) ? "ma" : "mu");
 }
\ No newline at end of file
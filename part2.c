@@ -1,20 +1,47 @@
+#include <stdint.h> // for INT32_MIN
 #include <stdio.h> // for stderr
-#include <stdlib.h> // for exit()
+#include <string.h> // for memcpy()
 #include "types.h"
 #include "utils.h"
 #include "riscv.h"
+#include "vector.h"
+#include "custom.h"
+#include "emulator.h"
 
 void execute_rtype(Instruction, Processor *);
 void execute_itype_except_load(Instruction, Processor *);
-void execute_branch(Instruction, Processor *);
-void execute_jal(Instruction, Processor *);
+void execute_branch(Instruction, Processor *, int);
+void execute_jal(Instruction, Processor *, int);
+void execute_jalr(Instruction, Processor *, int);
 void execute_load(Instruction, Processor *, Byte *);
 void execute_store(Instruction, Processor *, Byte *);
-void execute_ecall(Processor *, Byte *);
+void execute_ecall(Processor *, Emulator *);
+void execute_system(Instruction, Processor *, Emulator *);
 void execute_lui(Instruction, Processor *);
-void execute_lsgt(Byte *, Instruction, Processor *);
+void execute_auipc(Instruction, Processor *);
+void execute_atomic(Instruction, Processor *, Byte *);
+void execute_fence(Instruction, Processor *);
+void execute_custom(Instruction, Processor *, Byte *);
+void execute_vsetvl(Instruction, Processor *);
+void execute_vector(Instruction, Processor *);
+void execute_vector_load(Instruction, Processor *, Byte *);
+void execute_vector_store(Instruction, Processor *, Byte *);
 
-void execute_instruction(uint32_t instruction_bits, Processor *processor,Byte *memory) {    
+/* Executes one instruction on processor and returns EMULATOR_RUNNING, or the
+   reason it stopped the hart, in which case PC is left on the instruction */
+EmulatorStatus execute_instruction(uint32_t instruction_bits, Processor *processor,
+                                   Emulator *emulator) {
+    Byte *memory = emulator->memory;
+    // length of this instruction in bytes, 2 for RVC
+    int length = 4;
+    processor->status = EMULATOR_RUNNING;
+    if (is_compressed(instruction_bits, emulator->compressed)) {
+        instruction_bits = expand_compressed(instruction_bits & 0xFFFF, NULL);
+        if (instruction_bits == 0) {
+            return processor->status = EMULATOR_INVALID_INSTRUCTION;
+        }
+        length = 2;
+    }
     Instruction instruction = parse_instruction(instruction_bits);
     switch(instruction.opcode) {
         case 0x33:
@@ -24,13 +51,16 @@ void execute_instruction(uint32_t instruction_bits, Processor *processor,Byte *m
             execute_itype_except_load(instruction, processor);
             break;
         case 0x73:
-            execute_ecall(processor, memory);
+            execute_system(instruction, processor, emulator);
             break;
         case 0x63:
-            execute_branch(instruction, processor);
+            execute_branch(instruction, processor, length);
             break;
         case 0x6F:
-            execute_jal(instruction, processor);
+            execute_jal(instruction, processor, length);
+            break;
+        case 0x67:
+            execute_jalr(instruction, processor, length);
             break;
         case 0x23:
             execute_store(instruction, processor, memory);
@@ -41,18 +71,65 @@ void execute_instruction(uint32_t instruction_bits, Processor *processor,Byte *m
         case 0x37:
             execute_lui(instruction, processor);
             break;
+        case 0x17:
+            execute_auipc(instruction, processor);
+            break;
+        case 0x2F:
+            execute_atomic(instruction, processor, memory);
+            break;
+        case 0x0F:
+            execute_fence(instruction, processor);
+            break;
+        case 0x0b:
         case 0x2a:
-            execute_lsgt(memory, instruction, processor);
+        case 0x2b:
+        case 0x5b:
+        case 0x7b:
+            execute_custom(instruction, processor, memory);
+            break;
+        case 0x57:
+            execute_vector(instruction, processor);
+            break;
+        case 0x07:
+            execute_vector_load(instruction, processor, memory);
+            break;
+        case 0x27:
+            execute_vector_store(instruction, processor, memory);
             break;
         default: // undefined opcode
-            handle_invalid_instruction(instruction);
-            exit(-1);
+            processor->status = EMULATOR_INVALID_INSTRUCTION;
             break;
     }
-    if (instruction.opcode != 0x6F){
-        processor->PC += 4;
+    if (processor->status != EMULATOR_RUNNING) {
+        return processor->status;
     }
-    
+    if (instruction.opcode != 0x6F && instruction.opcode != 0x67){
+        processor->PC += length;
+    }
+    return EMULATOR_RUNNING;
+}
+
+/* DIV and REM as RISC-V defines them, so the guest never divides by zero
+   or overflows on the host: x / 0 is -1 and x % 0 is x, and INT32_MIN / -1
+   is INT32_MIN with remainder 0 */
+static sWord divide(sWord dividend, sWord divisor) {
+    if (divisor == 0) {
+        return -1;
+    }
+    if (dividend == INT32_MIN && divisor == -1) {
+        return INT32_MIN;
+    }
+    return dividend / divisor;
+}
+
+static sWord remainder_of(sWord dividend, sWord divisor) {
+    if (divisor == 0) {
+        return dividend;
+    }
+    if (dividend == INT32_MIN && divisor == -1) {
+        return 0;
+    }
+    return dividend % divisor;
 }
 
 void execute_rtype(Instruction instruction, Processor *processor) {
@@ -79,8 +156,7 @@ void execute_rtype(Instruction instruction, Processor *processor) {
                       ((sWord)processor->R[instruction.rtype.rs2]);
                     break;
                 default:
-                    handle_invalid_instruction(instruction);
-                    exit(-1);
+                    processor->status = EMULATOR_INVALID_INSTRUCTION;
                     break;
             }
             break;
@@ -118,12 +194,11 @@ void execute_rtype(Instruction instruction, Processor *processor) {
                 case 0x1:
                     // DIV
                     processor->R[instruction.rtype.rd] =
-                      ((sWord)processor->R[instruction.rtype.rs1]) /
-                      ((sWord)processor->R[instruction.rtype.rs2]);
+                      divide((sWord)processor->R[instruction.rtype.rs1],
+                             (sWord)processor->R[instruction.rtype.rs2]);
                     break;
                 default:
-                    handle_invalid_instruction(instruction);
-                    exit(-1);
+                    processor->status = EMULATOR_INVALID_INSTRUCTION;
                     break;
             }
             break;
@@ -147,8 +222,7 @@ void execute_rtype(Instruction instruction, Processor *processor) {
 
                     break;
                 default:
-                    handle_invalid_instruction(instruction);
-                    exit(-1);
+                    processor->status = EMULATOR_INVALID_INSTRUCTION;
                 break;
             }
             break;
@@ -163,12 +237,11 @@ void execute_rtype(Instruction instruction, Processor *processor) {
                 case 0x1:
                     // REM
                     processor->R[instruction.rtype.rd] =
-                      ((sWord)processor->R[instruction.rtype.rs1]) %
-                      ((sWord)processor->R[instruction.rtype.rs2]);
+                      remainder_of((sWord)processor->R[instruction.rtype.rs1],
+                                   (sWord)processor->R[instruction.rtype.rs2]);
                     break;
                 default:
-                    handle_invalid_instruction(instruction);
-                    exit(-1);
+                    processor->status = EMULATOR_INVALID_INSTRUCTION;
                     break;
             }
             break;
@@ -179,8 +252,7 @@ void execute_rtype(Instruction instruction, Processor *processor) {
                 ((sWord)processor->R[instruction.rtype.rs2]);
             break;
         default:
-            handle_invalid_instruction(instruction);
-            exit(-1);
+            processor->status = EMULATOR_INVALID_INSTRUCTION;
             break;
     }
 }
@@ -256,40 +328,94 @@ void execute_itype_except_load(Instruction instruction, Processor *processor) {
 
             break;
         default:
-            handle_invalid_instruction(instruction);
+            processor->status = EMULATOR_INVALID_INSTRUCTION;
             break;
     }
 }
 
-void execute_ecall(Processor *p, Byte *memory) {
+/* Reads one of the user counters into *value, returning 0 if csr is not one */
+static int read_counter(const Processor *processor, int csr, Word *value) {
+    switch (csr) {
+        case CSR_CYCLE:
+            *value = (Word)get_cycle_count(processor);
+            return 1;
+        case CSR_CYCLEH:
+            *value = (Word)(get_cycle_count(processor) >> 32);
+            return 1;
+        case CSR_TIME:
+            *value = (Word)get_time_count(processor);
+            return 1;
+        case CSR_TIMEH:
+            *value = (Word)(get_time_count(processor) >> 32);
+            return 1;
+        case CSR_INSTRET:
+            *value = (Word)processor->instret;
+            return 1;
+        case CSR_INSTRETH:
+            *value = (Word)(processor->instret >> 32);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/* ecall, ebreak and the Zicsr instructions. The only CSRs are the read-only
+   counters, so any instruction that would write one is illegal. The counters
+   read the value from before this instruction retires. */
+void execute_system(Instruction instruction, Processor *processor, Emulator *emulator) {
+    unsigned funct3 = instruction.itype.funct3;
+    Word value;
+
+    if (funct3 == 0x0 && instruction.itype.rd == 0 && instruction.itype.rs1 == 0 &&
+        instruction.itype.imm == 0) {
+        execute_ecall(processor, emulator);
+        return;
+    }
+    if (funct3 == 0x0 && instruction.itype.rd == 0 && instruction.itype.rs1 == 0 &&
+        instruction.itype.imm == 1) {
+        processor->status = EMULATOR_BREAKPOINT;
+        return;
+    }
+    // csrrw{i} always write; csrrs{i}/csrrc{i} write unless rs1/uimm is 0
+    int writes = (funct3 & 0x3) == 0x1 || instruction.itype.rs1 != 0;
+    if (funct3 == 0x0 || funct3 == 0x4 || writes ||
+        !read_counter(processor, instruction.itype.imm, &value)) {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+        return;
+    }
+    processor->R[instruction.itype.rd] = value;
+}
+
+void execute_ecall(Processor *p, Emulator *emulator) {
     Register i;
+    char text[16];
     
     // syscall number is given by a0 (x10)
     // argument is given by a1
     switch(p->R[10]) {
         case 1: // print an integer
-            printf("%d",p->R[11]);
+            emulator_print(emulator, text, snprintf(text, sizeof(text), "%d", p->R[11]));
             break;
         case 4: // print a string
-            for(i=p->R[11];i<MEMORY_SPACE && load(memory,i,LENGTH_BYTE);i++) {
-                printf("%c",load(memory,i,LENGTH_BYTE));
-            }
+            if (!check_address(p, p->R[11], LENGTH_BYTE))
+                break;
+            for(i=p->R[11];i<MEMORY_SPACE && load(emulator->memory,i,LENGTH_BYTE);i++);
+            emulator_print(emulator, (char *)emulator->memory + p->R[11], i - p->R[11]);
             break;
         case 10: // exit
-            printf("exiting the simulator\n");
-            exit(0);
+            p->status = EMULATOR_EXITED;
             break;
         case 11: // print a character
-            printf("%c",p->R[11]);
+            text[0] = p->R[11];
+            emulator_print(emulator, text, 1);
             break;
         default: // undefined ecall
-            printf("Illegal ecall number %d\n", p->R[10]);
-            exit(-1);
+            p->status = EMULATOR_ILLEGAL_ECALL;
             break;
     }
 }
 
-void execute_branch(Instruction instruction, Processor *processor) {
+void execute_branch(Instruction instruction, Processor *processor, int length) {
     switch (instruction.sbtype.funct3) {
         case 0x0:
             // BEQ
@@ -297,7 +423,7 @@ void execute_branch(Instruction instruction, Processor *processor) {
                 ((sWord)processor->R[instruction.sbtype.rs2])){
                 int offset = get_branch_offset(instruction);
                 processor->PC += offset;
-                processor->PC -= 4;
+                processor->PC -= length;
             }
             break;
         case 0x1:
@@ -306,98 +432,90 @@ void execute_branch(Instruction instruction, Processor *processor) {
                 ((sWord)processor->R[instruction.sbtype.rs2])){
                 int offset = get_branch_offset(instruction);
                 processor->PC += offset;
-                processor->PC -= 4;
+                processor->PC -= length;
             }
             break;
         default:
-            handle_invalid_instruction(instruction);
-            exit(-1);
+            processor->status = EMULATOR_INVALID_INSTRUCTION;
             break;
     }
 }
 
 void execute_load(Instruction instruction, Processor *processor, Byte *memory) {
+    Address address = (sWord)processor->R[instruction.itype.rs1] +
+        (sWord)sign_extend_number(instruction.itype.imm, 12);
+
     switch (instruction.itype.funct3) {
         case 0x0:
             // LB
-            processor->R[instruction.itype.rd] = sign_extend_number(
-                load(
-                    memory,
-                    ((sWord)processor->R[instruction.itype.rs1] +
-                        ((sWord)sign_extend_number(instruction.itype.imm, 12))),
-                    LENGTH_BYTE
-                    ), 8);
+            if (check_address(processor, address, LENGTH_BYTE))
+                processor->R[instruction.itype.rd] = sign_extend_number(
+                    load(memory, address, LENGTH_BYTE), 8);
             break;
         case 0x1:
             // LH
- 
-            processor->R[instruction.itype.rd] = sign_extend_number(
-                load(
-                    memory,
-                    ((sWord)processor->R[instruction.itype.rs1] +
-                        ((sWord)sign_extend_number(instruction.itype.imm, 12))),
-                    LENGTH_HALF_WORD
-                    ), 16);
+            if (check_address(processor, address, LENGTH_HALF_WORD))
+                processor->R[instruction.itype.rd] = sign_extend_number(
+                    load(memory, address, LENGTH_HALF_WORD), 16);
             break;
         case 0x2:
             // LW
-            processor->R[instruction.itype.rd] = 
-                load(
-                    memory,
-                    ((sWord)processor->R[instruction.itype.rs1] +
-                        ((sWord)sign_extend_number(instruction.itype.imm, 12))),
-                    LENGTH_WORD
-                    );
+            if (check_address(processor, address, LENGTH_WORD))
+                processor->R[instruction.itype.rd] =
+                    load(memory, address, LENGTH_WORD);
             break;
         default:
-            handle_invalid_instruction(instruction);
+            processor->status = EMULATOR_INVALID_INSTRUCTION;
             break;
     }
 }
 
 void execute_store(Instruction instruction, Processor *processor, Byte *memory) {
+    Address address = (sWord)processor->R[instruction.stype.rs1] +
+        (sWord)get_store_offset(instruction);
+    Word value = processor->R[instruction.stype.rs2];
+
     switch (instruction.stype.funct3) {
         case 0x0:
             // SB
-            store(
-                memory,
-                ((sWord)processor->R[instruction.stype.rs1]) +
-                    ((sWord)get_store_offset(instruction)),
-                LENGTH_BYTE,
-                processor->R[instruction.stype.rs2]);
+            if (check_address(processor, address, LENGTH_BYTE))
+                store(memory, address, LENGTH_BYTE, value);
             break;
         case 0x1:
             // SH
-            store(
-                memory,
-                ((sWord)processor->R[instruction.stype.rs1]) +
-                    ((sWord)get_store_offset(instruction)),
-                LENGTH_HALF_WORD,
-                processor->R[instruction.stype.rs2]);
+            if (check_address(processor, address, LENGTH_HALF_WORD))
+                store(memory, address, LENGTH_HALF_WORD, value);
             break;
         case 0x2:
             // SW
-            store(
-                memory,
-                ((sWord)processor->R[instruction.stype.rs1]) +
-                    ((sWord)get_store_offset(instruction)),
-                LENGTH_WORD,
-                processor->R[instruction.stype.rs2]);
+            if (check_address(processor, address, LENGTH_WORD))
+                store(memory, address, LENGTH_WORD, value);
             break;
         default:
-            handle_invalid_instruction(instruction);
-            exit(-1);
+            processor->status = EMULATOR_INVALID_INSTRUCTION;
             break;
     }
 }
 
-void execute_jal(Instruction instruction, Processor *processor) {
+void execute_jal(Instruction instruction, Processor *processor, int length) {
     /* YOUR CODE HERE */
     int offset = get_jump_offset(instruction);
-    processor->R[instruction.ujtype.rd] = processor->PC + 4;
+    processor->R[instruction.ujtype.rd] = processor->PC + length;
     processor->PC += offset;
 }
 
+void execute_jalr(Instruction instruction, Processor *processor, int length) {
+    if (instruction.itype.funct3 != 0x0) {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+        return;
+    }
+    // the target is computed before rd is written, since rd may be rs1
+    Address target = (processor->R[instruction.itype.rs1] +
+        sign_extend_number(instruction.itype.imm, 12)) & ~1U;
+    processor->R[instruction.itype.rd] = processor->PC + length;
+    processor->PC = target;
+}
+
 void execute_lui(Instruction instruction, Processor *processor) {
     /* YOUR CODE HERE */
     processor->R[instruction.utype.rd] = 
@@ -405,24 +523,370 @@ void execute_lui(Instruction instruction, Processor *processor) {
 
 }
 
-void execute_lsgt(Byte *memory, Instruction instruction, Processor *processor){
-    if ((sWord)processor->R[instruction.rtype.rs1] >
-        load(memory, (sWord)processor->R[instruction.rtype.rs2], LENGTH_WORD)) {
+void execute_auipc(Instruction instruction, Processor *processor) {
+    processor->R[instruction.utype.rd] = processor->PC +
+        (((sWord)sign_extend_number(instruction.utype.imm, 20)) << 12);
+}
+
+/* Host memory order for the aq/rl bits of an atomic */
+static int atomic_order(Instruction instruction) {
+    if (instruction.atype.aq && instruction.atype.rl) {
+        return __ATOMIC_SEQ_CST;
+    } else if (instruction.atype.aq) {
+        return __ATOMIC_ACQUIRE;
+    } else if (instruction.atype.rl) {
+        return __ATOMIC_RELEASE;
+    }
+    return __ATOMIC_RELAXED;
+}
+
+static Word atomic_min_max(int funct5, Word a, Word b) {
+    switch (funct5) {
+        case 0x10:
+            return (sWord)a < (sWord)b ? a : b;
+        case 0x14:
+            return (sWord)a > (sWord)b ? a : b;
+        case 0x18:
+            return a < b ? a : b;
+        default:
+            return a > b ? a : b;
+    }
+}
+
+/* RV32A. Each word is accessed with one host atomic, so harts on other
+   threads see every AMO as indivisible. sc.w succeeds if the word still
+   holds the value lr.w read, which a compare-and-swap checks; that is the
+   usual way to emulate a reservation on hosts without one. */
+void execute_atomic(Instruction instruction, Processor *processor, Byte *memory) {
+    Address address = processor->R[instruction.atype.rs1];
+    Word operand = processor->R[instruction.atype.rs2];
+    int order = atomic_order(instruction);
+    Word old, new, expected;
+
+    if (get_amo_name(instruction) == NULL || address % LENGTH_WORD != 0) {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+        return;
+    }
+    if (!check_address(processor, address, LENGTH_WORD))
+        return;
+    Word *word = (Word *)(memory + address);
+
+    switch (instruction.atype.funct5) {
+        case 0x02:
+            // LR.W; a load cannot be release-only, so lr.w.rl is made seq_cst
+            old = __atomic_load_n(word, order == __ATOMIC_RELEASE ? __ATOMIC_SEQ_CST : order);
+            processor->reserved = 1;
+            processor->reservation = address;
+            processor->reserved_value = old;
+            break;
+        case 0x03:
+            // SC.W writes 0 to rd on success and 1 on failure
+            expected = processor->reserved_value;
+            old = !(processor->reserved && processor->reservation == address &&
+                __atomic_compare_exchange_n(word, &expected, operand, 0, order,
+                    __ATOMIC_RELAXED));
+            processor->reserved = 0;
+            break;
+        case 0x01:
+            old = __atomic_exchange_n(word, operand, order);
+            break;
+        case 0x00:
+            old = __atomic_fetch_add(word, operand, order);
+            break;
+        case 0x04:
+            old = __atomic_fetch_xor(word, operand, order);
+            break;
+        case 0x08:
+            old = __atomic_fetch_or(word, operand, order);
+            break;
+        case 0x0C:
+            old = __atomic_fetch_and(word, operand, order);
+            break;
+        default:
+            // AMOMIN/AMOMAX[U] have no host instruction, so retry a CAS
+            old = __atomic_load_n(word, __ATOMIC_RELAXED);
+            do {
+                new = atomic_min_max(instruction.atype.funct5, old, operand);
+            } while (!__atomic_compare_exchange_n(word, &old, new, 1, order, __ATOMIC_RELAXED));
+            break;
+    }
+    processor->R[instruction.atype.rd] = old;
+}
+
+/* fence orders this hart's memory accesses for the other harts; fence.i is
+   a no-op because instructions are always fetched from guest memory */
+void execute_fence(Instruction instruction, Processor *processor) {
+    if (instruction.itype.funct3 == 0x0) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    } else if (instruction.itype.funct3 != 0x1) {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+    }
+}
+
+void execute_custom(Instruction instruction, Processor *processor, Byte *memory) {
+    const CustomInstruction *custom = find_custom_instruction(instruction);
+    if (custom == NULL) {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+        return;
+    }
+    custom->execute(instruction, processor, memory);
+}
+
+/* Element width in bytes selected by vtype, or 0 if vtype is illegal */
+static unsigned vector_sew(VectorRegisters *V) {
+    if (V->vtype >> 31) {
+        return 0;
+    }
+    return 1U << ((V->vtype >> 3) & 0x7);
+}
+
+/* Whether element i takes part, given the vm bit and the v0 mask */
+static int vector_active(VectorRegisters *V, int vm, unsigned i) {
+    return vm || ((V->v[0][i / 8] >> (i % 8)) & 0x1);
+}
+
+/* Writes the first vl active elements of result into vd. Tail and masked-off
+   elements are left undisturbed. */
+static void vector_commit(VectorRegisters *V, int vm, unsigned sew, Byte *vd, const Byte *result) {
+    if (vm) {
+        memcpy(vd, result, V->vl * sew);
+        return;
+    }
+    for (unsigned i = 0; i < V->vl; i++) {
+        if (vector_active(V, vm, i)) {
+            memcpy(vd + i * sew, result + i * sew, sew);
+        }
+    }
+}
+
+void execute_vsetvl(Instruction instruction, Processor *processor) {
+    VectorRegisters *V = &processor->V;
+    Word vtype, avl;
+
+    if ((instruction.bits >> 31) == 0) {
+        // vsetvli
+        vtype = (instruction.bits >> 20) & 0x7FF;
+    } else if ((instruction.bits >> 30) == 0x3) {
+        // vsetivli: AVL is the 5-bit immediate in the rs1 field
+        vtype = (instruction.bits >> 20) & 0x3FF;
+    } else if (instruction.varith.funct6 == 0x20 && !instruction.varith.vm) {
+        // vsetvl
+        vtype = processor->R[instruction.varith.vs2];
+    } else {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+        return;
+    }
+
+    if ((instruction.bits >> 30) == 0x3) {
+        avl = instruction.varith.vs1;
+    } else if (instruction.varith.vs1 != 0) {
+        avl = processor->R[instruction.varith.vs1];
+    } else if (instruction.varith.vd != 0) {
+        avl = 0xFFFFFFFF; // request VLMAX
+    } else {
+        avl = V->vl; // keep vl, change vtype
+    }
+
+    // only LMUL=1 with SEW of 8, 16 or 32 is supported; anything else sets vill
+    if ((vtype >> 8) != 0 || (vtype & 0x7) != 0 || ((vtype >> 3) & 0x7) > 2) {
+        V->vtype = 0x80000000;
+        V->vl = 0;
+    } else {
+        Word vlmax = VLENB >> ((vtype >> 3) & 0x7);
+        V->vtype = vtype;
+        V->vl = avl < vlmax ? avl : vlmax;
+    }
+    processor->R[instruction.varith.vd] = V->vl;
+}
+
+void execute_vector(Instruction instruction, Processor *processor) {
+    VectorRegisters *V = &processor->V;
+    Byte operand[VLENB], result[VLENB];
+    const Byte *vs1, *vs2;
+    Byte *vd;
+    unsigned sew, funct6, i;
+    Word scalar = 0;
+
+    if (instruction.varith.funct3 == 0x7) {
+        execute_vsetvl(instruction, processor);
+        return;
+    }
+    sew = vector_sew(V);
+    if (get_vector_name(instruction) == NULL || sew == 0) {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+        return;
+    }
+
+    funct6 = instruction.varith.funct6;
+    vd = V->v[instruction.varith.vd];
+    vs2 = V->v[instruction.varith.vs2];
+
+    // the second operand is vs1, or a scalar register/immediate splatted
+    switch (instruction.varith.funct3) {
+        case 0x0:
+        case 0x2:
+            vs1 = V->v[instruction.varith.vs1];
+            break;
+        default:
+            if (instruction.varith.funct3 == 0x3) {
+                scalar = sign_extend_number(instruction.varith.vs1, 5);
+            } else {
+                scalar = processor->R[instruction.varith.vs1];
+            }
+            for (i = 0; i < VLENB / sew; i++) {
+                vector_set_element(operand, i, sew, scalar);
+            }
+            vs1 = operand;
+            break;
+    }
+
+    if (instruction.varith.funct3 == 0x2 || instruction.varith.funct3 == 0x6) {
+        // OPM: reductions, vmul and the scalar moves
+        if (funct6 == 0x25) {
+            vector_binary(VECTOR_MUL, sew, result, vs2, vs1);
+            vector_commit(V, instruction.varith.vm, sew, vd, result);
+        } else if (funct6 == 0x10 && instruction.varith.funct3 == 0x2) {
+            // vmv.x.s
+            processor->R[instruction.varith.vd] =
+                sign_extend_number(vector_get_element(vs2, 0, sew), sew * 8);
+        } else if (funct6 == 0x10) {
+            // vmv.s.x
+            if (V->vl > 0) {
+                vector_set_element(vd, 0, sew, scalar);
+            }
+        } else {
+            // vredsum..vredmax share their funct6 order with the OPI ops
+            static const VectorOp reductions[8] = {
+                VECTOR_ADD, VECTOR_AND, VECTOR_OR, VECTOR_XOR,
+                VECTOR_MINU, VECTOR_MIN, VECTOR_MAXU, VECTOR_MAX
+            };
+            VectorOp op = reductions[funct6];
+            Word identity = vector_identity(op, sew);
+            for (i = 0; i < VLENB / sew; i++) {
+                if (i < V->vl && vector_active(V, instruction.varith.vm, i)) {
+                    vector_set_element(result, i, sew, vector_get_element(vs2, i, sew));
+                } else {
+                    vector_set_element(result, i, sew, identity);
+                }
+            }
+            if (V->vl > 0) {
+                vector_set_element(vd, 0, sew,
+                    vector_reduce(op, sew, result, vector_get_element(vs1, 0, sew)));
+            }
+        }
+    } else if (funct6 == 0x17) {
+        // vmv.v.v, vmv.v.x, vmv.v.i
+        vector_commit(V, 1, sew, vd, vs1);
+    } else if (funct6 >= 0x18) {
+        // compares write one mask bit per element
+        Word bits = vector_compare(funct6, sew, vs2, vs1);
+        for (i = 0; i < V->vl; i++) {
+            if (vector_active(V, instruction.varith.vm, i)) {
+                vd[i / 8] = (vd[i / 8] & ~(1 << (i % 8))) | (((bits >> i) & 0x1) << (i % 8));
+            }
+        }
+    } else {
+        if (funct6 == 0x03) {
+            // vrsub: scalar minus vector
+            vector_binary(VECTOR_SUB, sew, result, vs1, vs2);
+        } else {
+            vector_binary(funct6, sew, result, vs2, vs1);
+        }
+        vector_commit(V, instruction.varith.vm, sew, vd, result);
+    }
+}
+
+/* Vector loads and stores: unit-stride (mop 0) and strided (mop 2), with an
+   element width no wider than SEW so that EMUL stays within one register */
+static int vector_memory_valid(Instruction instruction, VectorRegisters *V) {
+    int width = get_vector_width(instruction);
+    unsigned sew = vector_sew(V);
+    return width != 0 && sew != 0 && width <= sew && instruction.vmem.nf == 0 &&
+           instruction.vmem.mew == 0 &&
+           ((instruction.vmem.mop == 0x0 && instruction.vmem.rs2 == 0) ||
+            instruction.vmem.mop == 0x2);
+}
 
-            processor->R[instruction.rtype.rd] = 
-                load(
-                    memory,
-                    ((sWord)processor->R[instruction.rtype.rs2]),
-                    LENGTH_WORD
-                    );
+/* Checks that every element from address on, stride bytes apart, lies in
+   guest memory, whichever way the stride runs; otherwise stops the hart */
+static int vector_span_valid(Processor *processor, Address address, sWord stride, int width) {
+    Word vl = processor->V.vl;
+    if (vl == 0) {
+        return 1;
+    }
+    int64_t last = (int64_t)address + (int64_t)(vl - 1) * stride;
+    int64_t low = last < address ? last : address;
+    int64_t high = last < address ? address : last;
+    if (low < 0 || high > MEMORY_SPACE - width) {
+        processor->status = EMULATOR_INVALID_ADDRESS;
+        processor->fault_address = (Address)(low < 0 ? low : high);
+        return 0;
+    }
+    return 1;
+}
+
+void execute_vector_load(Instruction instruction, Processor *processor, Byte *memory) {
+    VectorRegisters *V = &processor->V;
+    if (!vector_memory_valid(instruction, V)) {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+        return;
+    }
+    int width = get_vector_width(instruction);
+    Address address = processor->R[instruction.vmem.rs1];
+    sWord stride = instruction.vmem.mop == 0x2 ? (sWord)processor->R[instruction.vmem.rs2] : width;
+    Byte *vd = V->v[instruction.vmem.vd];
+
+    if (!vector_span_valid(processor, address, stride, width)) {
+        return;
+    }
+    if (instruction.vmem.mop == 0x0 && instruction.vmem.vm) {
+        memcpy(vd, memory + address, V->vl * width);
+        return;
+    }
+    for (unsigned i = 0; i < V->vl; i++) {
+        if (vector_active(V, instruction.vmem.vm, i)) {
+            memcpy(vd + i * width, memory + address + i * stride, width);
+        }
+    }
+}
+
+void execute_vector_store(Instruction instruction, Processor *processor, Byte *memory) {
+    VectorRegisters *V = &processor->V;
+    if (!vector_memory_valid(instruction, V)) {
+        processor->status = EMULATOR_INVALID_INSTRUCTION;
+        return;
+    }
+    int width = get_vector_width(instruction);
+    Address address = processor->R[instruction.vmem.rs1];
+    sWord stride = instruction.vmem.mop == 0x2 ? (sWord)processor->R[instruction.vmem.rs2] : width;
+    const Byte *vs3 = V->v[instruction.vmem.vd];
+
+    if (!vector_span_valid(processor, address, stride, width)) {
+        return;
+    }
+    if (instruction.vmem.mop == 0x0 && instruction.vmem.vm) {
+        memcpy(memory + address, vs3, V->vl * width);
+        return;
+    }
+    for (unsigned i = 0; i < V->vl; i++) {
+        if (vector_active(V, instruction.vmem.vm, i)) {
+            memcpy(memory + address + i * stride, vs3 + i * width, width);
         }
-    // processor->R[instruction.rtype.rd] =
-    //     ((sWord)processor->R[instruction.rtype.rs1] >
-    //     load(memory, (sWord)instruction.rtype.rs2, LENGTH_WORD))?: load(memory, instruction.rtype.rs2, LENGTH_WORD);
+    }
+}
+
+int check_address(Processor *processor, Address address, Word length) {
+    if (length <= MEMORY_SPACE && address <= MEMORY_SPACE - length)
+        return 1;
+    processor->status = EMULATOR_INVALID_ADDRESS;
+    processor->fault_address = address;
+    return 0;
 }
 
 void store(Byte *memory, Address address, Alignment alignment, Word value) {
     /* YOUR CODE HERE */
+    if (address > MEMORY_SPACE - alignment)
+        return;
     if (alignment == LENGTH_WORD)
     {
         memory[address] = (Byte)(value & 0x000000ff);
@@ -447,6 +911,8 @@ Word load(Byte *memory, Address address, Alignment alignment) {
     /* YOUR CODE HERE */
     Word word = 0x00000000;
 
+    if (address > MEMORY_SPACE - alignment)
+        return word;
     if (alignment == LENGTH_WORD){
         word |= memory[address];
         word |= memory[address + 1] << 8;
@@ -0,0 +1,40 @@
+#include <stddef.h>
+#include "../types.h"
+#include "../custom.h"
+
+/* Example accelerator plugin on custom-1 (0x2b), built with `make plugins`
+   and loaded with `./riscv -p plugins/accel.so ...` */
+
+/* mac rd, rs1, rs2: rd += rs1 * rs2 */
+static void execute_mac(Instruction instruction, Processor *processor, Byte *memory) {
+    processor->R[instruction.rtype.rd] +=
+        (sWord)processor->R[instruction.rtype.rs1] *
+        (sWord)processor->R[instruction.rtype.rs2];
+}
+
+/* acc rd, rs1, rs2: rd += rs1 + rs2 */
+static void execute_acc(Instruction instruction, Processor *processor, Byte *memory) {
+    processor->R[instruction.rtype.rd] +=
+        processor->R[instruction.rtype.rs1] + processor->R[instruction.rtype.rs2];
+}
+
+/* gep rd, rs1, rs2: address of element rs2 in an array of 16-byte elements at rs1 */
+static void execute_gep(Instruction instruction, Processor *processor, Byte *memory) {
+    processor->R[instruction.rtype.rd] =
+        processor->R[instruction.rtype.rs1] + (processor->R[instruction.rtype.rs2] << 4);
+}
+
+static const CustomInstruction accel[] = {
+    {"mac", 0x2b, 0x0, 0x0, NULL, NULL, execute_mac},
+    {"acc", 0x2b, 0x1, 0x0, NULL, NULL, execute_acc},
+    {"gep", 0x2b, 0x2, 0x0, NULL, NULL, execute_gep},
+};
+
+int riscv_plugin_init(void) {
+    for (unsigned i = 0; i < sizeof(accel) / sizeof(accel[0]); i++) {
+        if (register_custom_instruction(&accel[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include "pool.h"
+
+typedef struct Pool Pool;
+
+/* The indices [begin, end) a thread has yet to run. The owner takes from
+   the front and thieves from the back, both under the lock. */
+typedef struct {
+    pthread_mutex_t lock;
+    int begin;
+    int end;
+    pthread_t thread;
+    Pool *pool;
+} Worker;
+
+struct Pool {
+    Worker *workers;
+    int nworkers;
+    PoolTask task;
+    void *opaque;
+};
+
+static int take(Worker *worker) {
+    int index = -1;
+    pthread_mutex_lock(&worker->lock);
+    if (worker->begin < worker->end) {
+        index = worker->begin++;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return index;
+}
+
+/* Moves the back half of another worker's indices to this one, which has
+   none left. Returns 0 once every worker is out of work. */
+static int steal(Worker *thief) {
+    Pool *pool = thief->pool;
+    int self = thief - pool->workers;
+
+    for (int i = 1; i < pool->nworkers; i++) {
+        Worker *victim = &pool->workers[(self + i) % pool->nworkers];
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->end - victim->begin;
+        if (left > 0) {
+            int end = victim->end;
+            victim->end -= (left + 1) / 2;
+            pthread_mutex_unlock(&victim->lock);
+
+            pthread_mutex_lock(&thief->lock);
+            thief->begin = end - (left + 1) / 2;
+            thief->end = end;
+            pthread_mutex_unlock(&thief->lock);
+            return 1;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return 0;
+}
+
+static void *work(void *arg) {
+    Worker *worker = arg;
+    do {
+        int index;
+        while ((index = take(worker)) >= 0) {
+            worker->pool->task(worker->pool->opaque, index);
+        }
+    } while (steal(worker));
+    return NULL;
+}
+
+int pool_run(int ntasks, int nthreads, PoolTask task, void *opaque) {
+    Pool pool = {NULL, nthreads < 1 ? 1 : nthreads, task, opaque};
+    int started, result = 0;
+
+    pool.workers = calloc(pool.nworkers, sizeof(Worker));
+    if (pool.workers == NULL) {
+        for (int i = 0; i < ntasks; i++) {
+            task(opaque, i);
+        }
+        return -1;
+    }
+    for (int i = 0; i < pool.nworkers; i++) {
+        Worker *worker = &pool.workers[i];
+        pthread_mutex_init(&worker->lock, NULL);
+        worker->begin = (long)ntasks * i / pool.nworkers;
+        worker->end = (long)ntasks * (i + 1) / pool.nworkers;
+        worker->pool = &pool;
+    }
+
+    // worker 0 is the calling thread; work left by any that fail is stolen
+    for (started = 1; started < pool.nworkers; started++) {
+        if (pthread_create(&pool.workers[started].thread, NULL, work,
+                           &pool.workers[started]) != 0) {
+            result = -1;
+            break;
+        }
+    }
+    work(&pool.workers[0]);
+    for (int i = 1; i < started; i++) {
+        pthread_join(pool.workers[i].thread, NULL);
+    }
+
+    for (int i = 0; i < pool.nworkers; i++) {
+        pthread_mutex_destroy(&pool.workers[i].lock);
+    }
+    free(pool.workers);
+    return result;
+}
@@ -0,0 +1,14 @@
+#ifndef POOL_H
+#define POOL_H
+
+/* One unit of work, identified by its index */
+typedef void (*PoolTask)(void *opaque, int index);
+
+/* Runs task(opaque, i) for every i below ntasks on nthreads host threads,
+   one of them the caller's, and returns when all are done. Each thread
+   starts on its own contiguous share of the indices; one that runs out
+   steals half of what another has left. Returns -1 if some threads could
+   not be started, in which case the rest still run every task. */
+int pool_run(int ntasks, int nthreads, PoolTask task, void *opaque);
+
+#endif
@@ -1,5 +1,17 @@
 #include "riscv.h"
+#include "utils.h"
+#include "custom.h"
+#include "emulator.h"
+#include "memory.h"
+#include "jobs.h"
+#include "server.h"
+#include "checkpoint.h"
+#include "timeline.h"
+#include "gdb.h"
+#include "trace.h"
+#include "filter.h"
 #include <assert.h>
+#include <ctype.h>
 #include <getopt.h>
 #include <stdarg.h>
 #include <stdint.h>
@@ -9,103 +21,227 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
-/* WARNING: DO NOT CHANGE THIS FILE.
- YOU PROBABLY DON'T EVEN NEED TO LOOK AT IT... */
+/* The command-line front end of librv32emu: loads a program into one
+ * emulator and runs it, one instruction at a time when it has to prompt or
+ * print the trace. */
 
-// Pointer to simulator memory
-Byte *memory;
-#define MAX_SIZE 50
+/* Unless it steps, a run with -r writes its trace, and everything else it
+ * prints to stdout, through a sink, in the format --binary-trace picks;
+ * with --async-trace a thread of its own formats and writes it, and with
+ * --expect it is only compared with a reference trace */
+static TraceFormat trace_format = TRACE_TEXT;
+static int trace_async;
+static const char *trace_reference;
 
-void execute(Processor *processor, int prompt, int print) {
-  /* fetch an instruction */
-  uint32_t instruction_bits = load(memory, processor->PC, LENGTH_WORD);
+/* The run being made, with its trace, the --trace filters (see filter.h)
+ * and the --watch addresses */
+static Run run;
 
-  /* interactive-mode prompt */
-  if (prompt) {
-    if (prompt == 1) {
-      printf("simulator paused,enter to continue...");
-      while (getchar() != '\n')
-        ;
-    }
+/* How often -i saves the machine so it can go back; see timeline.h */
+static Double snapshot_interval = 10000;
 
-    printf("%08x: ", processor->PC);
-    decode_instruction(instruction_bits);
+static void print_position(Timeline *timeline, Emulator *emulator, int print) {
+  printf("instruction %llu, pc %08x\n", (unsigned long long)timeline_now(timeline),
+         emulator->harts[0].PC);
+  if (print) {
+    print_registers(stdout, emulator->harts[0].R);
   }
+}
 
-  execute_instruction(instruction_bits, processor, memory);
-
-  // enforce $0 being hard-wired to 0
-  processor->R[0] = 0;
+/* -i: pauses before each instruction. Enter runs it, and a command moves
+ * the machine instead: "rs" steps back one instruction, "rc ADDR" goes back
+ * to the last time the PC was ADDR (hex), or to the start, and "g K" goes
+ * to instruction K. */
+static EmulatorStatus run_interactive(Emulator *emulator, Double budget, int print) {
+  Timeline *timeline = timeline_create(emulator, snapshot_interval);
+  EmulatorStatus status = EMULATOR_RUNNING;
+  unsigned long long k;
+  unsigned pc;
+  char line[64];
 
-  // print trace
-  if (print) {
-    int i, j;
+  if (timeline == NULL) {
+    fprintf(stderr, "Cannot record the run; going back is off\n");
+    return run_for(&run, budget, 1, print);
+  }
+  while (status == EMULATOR_RUNNING && timeline_now(timeline) < budget) {
+    printf("simulator paused,enter to continue...");
+    fflush(stdout);
+    if (fgets(line, sizeof(line), stdin) == NULL) {
+      strcpy(line, "\n");
+    }
 
-    for (i = 0; i < 8; i++) {
-      for (j = 0; j < 4; j++) {
-        printf("r%2d=%08x ", i * 4 + j, processor->R[i * 4 + j]);
+    if (sscanf(line, "g %llu", &k) == 1) {
+      status = timeline_goto(timeline, k);
+    } else if (strncmp(line, "rs", 2) == 0) {
+      Double now = timeline_now(timeline);
+      status = timeline_goto(timeline, now > 0 ? now - 1 : 0);
+    } else if (sscanf(line, "rc %x", &pc) == 1) {
+      timeline_reverse_continue(timeline, pc);
+    } else {
+      Processor *processor = &emulator->harts[0];
+      show_instruction(emulator, processor->PC);
+      status = timeline_goto(timeline, timeline_now(timeline) + 1);
+      if (status == EMULATOR_RUNNING && print) {
+        print_registers(stdout, processor->R);
       }
-
-      puts("");
+      continue;
+    }
+    if (status == EMULATOR_RUNNING) {
+      print_position(timeline, emulator, print);
     }
-
-    printf("\n");
   }
+  timeline_free(timeline);
+  return status;
 }
 
-void init_args(Processor *processor, char *arg) {
-  char *token = strtok(arg, ",");
-  int i = 0;
-  while (token != NULL) {
-    processor->R[i + 10] = (int32_t)strtol(token, NULL, 16);
-    token = strtok(NULL, ",");
-    i++;
+/* Runs for budget instructions, pausing before each one with -i */
+static EmulatorStatus run_stretch(Double budget, int prompt, int print) {
+  if (prompt == 1) {
+    return run_interactive(run.emulator, budget, print);
   }
+  return run_for(&run, budget, prompt, print);
 }
 
-int load_file(uint8_t *mem, size_t memsize, int startaddr, const char *filename,
-              int disasm) {
-  FILE *file = fopen(filename, "r");
-  char line[MAX_SIZE];
-  int instruction, offset = 0;
-  int programsize = 0;
-  while (fgets(line, MAX_SIZE, file) != NULL) {
-    instruction = (int32_t)strtol(line, NULL, 16);
-    programsize++;
-    mem[startaddr + offset] = instruction & 0xFF;
-    mem[startaddr + offset + 1] = (instruction >> 8) & 0xFF;
-    mem[startaddr + offset + 2] = (instruction >> 16) & 0xFF;
-    mem[startaddr + offset + 3] = (instruction >> 24) & 0xFF;
+static int close_trace(void) {
+  int result = run.trace != NULL ? trace_close(run.trace) : 0;
+  run.trace = NULL;
+  return result;
+}
+
+/* Runs a loaded or restored machine to the end of its budget and prints
+ * how it ended. With a checkpoint file, the machine is saved once it has
+ * run checkpoint_at instructions, and then carries on. */
+static int run_machine(Emulator *emulator, Double budget, int opt_interactive, int opt_regdump,
+                       int opt_counters, Double checkpoint_at, const char *checkpoint_file) {
+  if (emulator->nharts > 1 && (opt_interactive || opt_regdump)) {
+    fprintf(stderr, "Tracing and stepping need a single hart\n");
+    return -1;
+  }
+  FILE *out = stdout;
+  run.emulator = emulator;
+  if (opt_regdump && !opt_interactive) {
+    fflush(stdout);
+    if (trace_reference != NULL) {
+      run.trace = trace_expect(STDOUT_FILENO, trace_reference);
+      if (run.trace == NULL) {
+        fprintf(stderr, "Cannot read %s\n", trace_reference);
+        disarm_watches(&run.watches);
+        emulator_destroy(emulator);
+        return -1;
+      }
+    } else {
+      run.trace = trace_open(STDOUT_FILENO, trace_format, trace_async);
+      assert(run.trace != NULL);
+      // a trace that leaves steps out says which each one is
+      trace_select(run.trace, run.filter.registers, trace_filter_active(&run.filter));
+    }
+    assert(run.trace != NULL);
+    out = trace_output(run.trace);
+    emulator->output = write_stream;
+    emulator->output_opaque = out;
+  }
+
+  Double first = checkpoint_file != NULL && checkpoint_at < budget ? checkpoint_at : budget;
+  EmulatorStatus status = run_stretch(first, opt_interactive, opt_regdump);
+  if (status == EMULATOR_RUNNING && first < budget) {
+    if (emulator_save(emulator, checkpoint_file, budget - first) != 0) {
+      fprintf(stderr, "Cannot save a checkpoint to %s\n", checkpoint_file);
+      close_trace();
+      disarm_watches(&run.watches);
+      emulator_destroy(emulator);
+      return -1;
+    }
+    status = run_stretch(budget - first, opt_interactive, opt_regdump);
+  }
 
-    if (disasm) {
-      printf("%08x: ", startaddr + offset);
-      decode_instruction((uint32_t)instruction);
+  int result = (int)status < 0 ? -1 : print_status(out, emulator, status);
+  TraceStats trace_counters = {0};
+  if (run.trace != NULL) {
+    trace_stats(run.trace, &trace_counters);
+  }
+  if (close_trace() != 0) {
+    if (trace_reference == NULL) {
+      fprintf(stderr, "Cannot write the trace\n");
     }
+    result = -1;
+  }
 
-    offset += 4;
+  if (opt_counters) {
+    for (int i = 0; i < emulator->nharts; i++) {
+      Processor *hart = &emulator->harts[i];
+      char prefix[24] = "";
+      if (emulator->nharts > 1) {
+        snprintf(prefix, sizeof(prefix), "hart %d ", i);
+      }
+      fprintf(stderr, "%sinstret: %llu\n%scycle: %llu\n", prefix,
+              (unsigned long long)hart->instret, prefix,
+              (unsigned long long)get_cycle_count(hart));
+    }
+    if (trace_counters.slots > 0) {
+      fprintf(stderr, "trace records: %llu\ntrace stalls: %llu\n"
+              "trace ring peak: %llu of %llu\ntrace ring mean: %.1f\n",
+              (unsigned long long)trace_counters.records,
+              (unsigned long long)trace_counters.stalls,
+              (unsigned long long)trace_counters.peak,
+              (unsigned long long)trace_counters.slots, trace_counters.mean);
+    }
   }
-  return programsize;
+  disarm_watches(&run.watches);
+  emulator_destroy(emulator);
+  return result;
 }
 
 int main(int argc, char **argv) {
+  trace_filter_init(&run.filter);
+
   /* options */
   int opt_disasm = 0, opt_regdump = 0, opt_interactive = 0, opt_exit = 0,
-      opt_init_reg = 0;
+      opt_init_reg = 0, opt_counters = 0, opt_fork_server = 0;
 
-  /* the architectural state of the CPU */
-  Processor processor;
-  /* initialize the CPU */
-  /* zero out all registers */
-  // int i;
-  for (int i = 0; i < 32; i++) {
-    processor.R[i] = 0;
-  }
+  /* the machine: CPU, memory, and the PC, sp and gp it starts with */
+  Emulator *emulator = emulator_create();
+  assert(emulator != NULL);
+  Processor *processor = &emulator->harts[0];
+  int nharts = 0;
 
   char *data_file = NULL;
+  char *job_file = NULL;
+  char *sweep_file = NULL;
+  char *serve_path = NULL, *client_path = NULL;
+  char *image_directory = NULL;
+  char *checkpoint_file = NULL, *restore_file = NULL;
+  char *gdb_address = NULL;
+  char *watch_requests[MAX_WATCHES];
+  int opt_binary_trace = 0;
+  int nwatch_requests = 0;
+  Double checkpoint_at = 0;
   // int a1;
   /* parse the command-line args */
+  static const struct option long_options[] = {
+      {"sweep", required_argument, NULL, 'w'},
+      {"serve", required_argument, NULL, 'S'},
+      {"client", required_argument, NULL, 'C'},
+      {"fork-server", no_argument, NULL, 'F'},
+      {"shared-image", required_argument, NULL, 'I'},
+      {"checkpoint-at", required_argument, NULL, 'K'},
+      {"restore", required_argument, NULL, 'R'},
+      {"snapshot-every", required_argument, NULL, 'E'},
+      {"gdb", required_argument, NULL, 'G'},
+      {"watch", required_argument, NULL, 'W'},
+      {"binary-trace", no_argument, NULL, 'B'},
+      {"decode-trace", required_argument, NULL, 'D'},
+      {"async-trace", no_argument, NULL, 'A'},
+      {"trace-at", required_argument, NULL, 'T'},
+      {"expect", required_argument, NULL, 'X'},
+      {"trace-window", required_argument, NULL, 'y'},
+      {"trace-every", required_argument, NULL, 'N'},
+      {"trace-pc", required_argument, NULL, 'P'},
+      {"trace-ecalls", required_argument, NULL, 'L'},
+      {"trace-registers", required_argument, NULL, 'M'},
+      {NULL, 0, NULL, 0},
+  };
   int c;
-  while ((c = getopt(argc, argv, "dvrites:a:")) != -1) {
+  while ((c = getopt_long(argc, argv, "dvritecs:a:p:n:b:", long_options, NULL)) != -1) {
     switch (c) {
     case 'd':
       opt_disasm = 1;
@@ -125,11 +261,153 @@ int main(int argc, char **argv) {
     case 'e':
       opt_exit = 1;
       break;
+    case 'c':
+      opt_counters = 1;
+      break;
     case 's':
       data_file = optarg;
       break;
+    case 'n':
+      nharts = atoi(optarg);
+      break;
+    case 'b':
+      job_file = optarg;
+      break;
+    case 'w':
+      sweep_file = optarg;
+      break;
+    case 'S':
+      serve_path = optarg;
+      break;
+    case 'C':
+      client_path = optarg;
+      break;
+    case 'F':
+      opt_fork_server = 1;
+      break;
+    case 'I':
+      image_directory = optarg;
+      break;
+    case 'K':
+      // --checkpoint-at N file
+      if (optind >= argc) {
+        fprintf(stderr, "--checkpoint-at needs a count and a file\n");
+        return -1;
+      }
+      checkpoint_at = strtoull(optarg, NULL, 10);
+      checkpoint_file = argv[optind++];
+      break;
+    case 'R':
+      restore_file = optarg;
+      break;
+    case 'E':
+      snapshot_interval = strtoull(optarg, NULL, 10);
+      break;
+    case 'G':
+      gdb_address = optarg;
+      break;
+    case 'B':
+      opt_binary_trace = 1;
+      trace_format = TRACE_BINARY;
+      break;
+    case 'A':
+      trace_async = 1;
+      break;
+    case 'X':
+      trace_reference = optarg;
+      break;
+    case 'y': {
+      // --trace-window START[,END]: the indices of the steps, from 0
+      unsigned long long start, end;
+      int fields = sscanf(optarg, "%llu,%llu", &start, &end);
+      if (fields < 1 || (fields == 2 && end <= start)) {
+        fprintf(stderr, "Bad --trace-window %s\n", optarg);
+        return -1;
+      }
+      run.filter.start = start;
+      run.filter.end = fields == 2 ? end : EMULATOR_FOREVER;
+      break;
+    }
+    case 'N':
+      run.filter.every = strtoull(optarg, NULL, 10);
+      if (run.filter.every == 0) {
+        fprintf(stderr, "Bad --trace-every %s\n", optarg);
+        return -1;
+      }
+      break;
+    case 'P': {
+      // --trace-pc LOW,HIGH in hex: the steps of instructions in [LOW, HIGH)
+      unsigned low, high;
+      if (sscanf(optarg, "%x,%x", &low, &high) != 2 || high <= low) {
+        fprintf(stderr, "Bad --trace-pc %s\n", optarg);
+        return -1;
+      }
+      run.filter.low = low;
+      run.filter.high = high;
+      break;
+    }
+    case 'L':
+      run.filter.around = strtoull(optarg, NULL, 10);
+      run.filter.ecalls = 1;
+      break;
+    case 'M': {
+      // --trace-registers 10,11,x2: the registers each step shows
+      run.filter.registers = 0;
+      for (char *rest = optarg, *name; (name = strsep(&rest, ",")) != NULL;) {
+        char *digits = name + (*name == 'x' || *name == 'r'), *end;
+        long number = strtol(digits, &end, 10);
+        // strtol() would take "", " 5" or "+5"; only the digits are a number
+        if (!isdigit((unsigned char)*digits) || *end != '\0' || number > 31) {
+          fprintf(stderr, "Bad register %s\n", name);
+          return -1;
+        }
+        run.filter.registers |= 1u << number;
+      }
+      break;
+    }
+    case 'D': {
+      // --decode-trace FILE prints a binary trace as -r would have
+      FILE *in = fopen(optarg, "r");
+      int result = in != NULL ? trace_decode(in, stdout) : -1;
+      if (result != 0) {
+        fprintf(stderr, "Cannot decode %s\n", optarg);
+      }
+      if (in != NULL) {
+        fclose(in);
+      }
+      emulator_destroy(emulator);
+      return result;
+    }
+    case 'T': {
+      // --trace-at N FILE prints the registers the N-th instruction (from
+      // 0) left in a binary trace, as -r printed them, after its PC
+      if (optind >= argc) {
+        fprintf(stderr, "--trace-at needs an instruction and a file\n");
+        return -1;
+      }
+      Double index = strtoull(optarg, NULL, 10);
+      const char *path = argv[optind++];
+      int result = trace_print_step(path, index, stdout);
+      if (result != 0) {
+        fprintf(stderr, "Cannot find instruction %llu in %s\n", (unsigned long long)index, path);
+      }
+      emulator_destroy(emulator);
+      return result;
+    }
+    case 'W':
+      if (nwatch_requests == MAX_WATCHES) {
+        fprintf(stderr, "At most %d watchpoints\n", MAX_WATCHES);
+        return -1;
+      }
+      watch_requests[nwatch_requests++] = optarg;
+      break;
+    case 'p':
+      if (load_plugin(optarg) != 0) {
+        return -1;
+      }
+      break;
     case 'a':
-      init_args(&processor, optarg);
+      init_args(processor, optarg);
       // opt_a1 = 1;
       // Read hex value as integer
       // a1 = (int32_t)strtol(optarg, NULL, 16);
@@ -140,18 +418,74 @@ int main(int argc, char **argv) {
     }
   }
 
+  /* --binary-trace changes what -r writes, for a run that is not stepped */
+  if (opt_binary_trace && (!opt_regdump || opt_interactive)) {
+    fprintf(stderr, "--binary-trace needs -r and cannot be used with -i or -t\n");
+    return -1;
+  }
+  if (trace_async && (!opt_regdump || opt_interactive)) {
+    fprintf(stderr, "--async-trace needs -r and cannot be used with -i or -t\n");
+    return -1;
+  }
+  /* --expect compares what -r would write with a text trace instead */
+  int filtered = trace_filter_active(&run.filter) || run.filter.registers != TRACE_ALL_REGISTERS;
+  if (trace_reference != NULL &&
+      (!opt_regdump || opt_interactive || opt_binary_trace || trace_async || filtered)) {
+    fprintf(stderr, "--expect needs -r and cannot be used with -i, -t, --binary-trace, "
+            "--async-trace or the --trace filters\n");
+    return -1;
+  }
+  if (filtered && (!opt_regdump || opt_interactive || opt_binary_trace)) {
+    fprintf(stderr, "The --trace filters need -r and cannot be used with -i, -t or "
+            "--binary-trace\n");
+    return -1;
+  }
+  /* --trace-ecalls runs ahead from a snapshot, which tracks the memory */
+  if (run.filter.ecalls && nwatch_requests > 0) {
+    fprintf(stderr, "--watch cannot be used with --trace-ecalls\n");
+    return -1;
+  }
+
+  /* -i records the run by write-protecting the whole memory, and keeps one
+   * timeline for it from start to end */
+  if (nwatch_requests > 0 && opt_interactive == 1) {
+    fprintf(stderr, "--watch cannot be used with -i\n");
+    return -1;
+  }
+  if (checkpoint_file != NULL && opt_interactive == 1) {
+    fprintf(stderr, "--checkpoint-at cannot be used with -i\n");
+    return -1;
+  }
+
   if (opt_init_reg) {
     for (int i = 0; i < 32; i++) {
-      processor.R[i] = 4;
+      processor->R[i] = 4;
     }
+    processor->R[3] = 0x3000;
+    processor->R[2] = 0xEFFFF;
   }
 
-  /* Set the global pointer to 0x3000. We arbitrarily call this the middle of
-   * the static data segment */
-  processor.R[3] = 0x3000;
+  /* the daemon and its client take their programs from the requests */
+  if (serve_path != NULL || client_path != NULL) {
+    emulator_destroy(emulator);
+    return serve_path != NULL ? serve(serve_path) : serve_client(client_path);
+  }
 
-  /* Set the stack pointer near the top of the memory array */
-  processor.R[2] = 0xEFFFF;
+  /* --restore picks the run up where --checkpoint-at left it */
+  if (restore_file != NULL) {
+    Double budget;
+    emulator_destroy(emulator);
+    emulator = emulator_open(restore_file, &budget);
+    if (emulator == NULL) {
+      fprintf(stderr, "Cannot restore %s\n", restore_file);
+      return -1;
+    }
+    if (arm_watches(&run.watches, emulator, watch_requests, nwatch_requests) != 0) {
+      return -1;
+    }
+    return run_machine(emulator, opt_exit ? EMULATOR_FOREVER : budget, opt_interactive,
+                       opt_regdump, opt_counters, checkpoint_at, checkpoint_file);
+  }
 
   /* make sure we got an executable filename on the command line */
   if (argc <= optind) {
@@ -159,48 +493,85 @@ int main(int argc, char **argv) {
     return -1;
   }
 
-  /* load the executable into memory */
-  assert(memory == NULL);
-  memory = calloc(MEMORY_SPACE, sizeof(uint8_t)); // allocate zeroed memory
-  assert(memory != NULL);
-  int prog_numins = 0;
-  /* SEt the PC to 0x1000 */
-  processor.PC = 0x1000;
-  prog_numins =
-      load_file(memory, MEMORY_SPACE, processor.PC, argv[optind], opt_disasm);
+  /* load the executable into memory at the PC */
+  int prog_numins = emulator_load(emulator, argv[optind], processor->PC, 1);
+  if (prog_numins < 0) {
+    fprintf(stderr, "Cannot read %s\n", argv[optind]);
+    return -1;
+  }
+  /* with --shared-image, the program's pages come from a file that every
+   * process running it maps; data loaded next goes to private pages */
+  if (image_directory != NULL && emulator_share(emulator, image_directory) != 0) {
+    fprintf(stderr, "Cannot map the program image\n");
+    return -1;
+  }
   // Loading data
-  if (data_file != NULL) {
-    load_file(memory, MEMORY_SPACE, processor.R[3], data_file, 0);
+  if (data_file != NULL && emulator_load(emulator, data_file, processor->R[3], 0) < 0) {
+    fprintf(stderr, "Cannot read %s\n", data_file);
+    return -1;
   }
-  // for (int i = processor.R[3]; i < processor.R[3] + data_size * 4; i += 4) {
-  //   Word result = load(memory, i, LENGTH_WORD);
-  //   printf("%08x, %08x \n", i, result);
-  // }
 
   /* if we're just disassembling,exit here */
   if (opt_disasm) {
+    disassemble(emulator, processor->PC, prog_numins);
     return 0;
   }
 
+  /* Either simulate forever, or for program instructions */
+  Double budget = opt_exit ? EMULATOR_FOREVER : (Double)prog_numins;
 
+  /* -b and --sweep run each job on a copy-on-write clone of the program
+   * as loaded so far */
+  if (job_file != NULL || sweep_file != NULL) {
+    if (emulator_freeze(emulator) != 0) {
+      fprintf(stderr, "Cannot share the program image\n");
+      return -1;
+    }
+    int result = job_file != NULL ? run_batch(emulator, job_file, budget, opt_regdump)
+                                  : run_sweep(emulator, sweep_file, budget, opt_regdump);
+    emulator_destroy(emulator);
+    if (opt_counters) {
+      MemoryPoolStats stats;
+      memory_pool_stats(&stats);
+      fprintf(stderr, "memory allocations: %llu\nmemory pool hits: %llu\n"
+              "memory recycled: %llu bytes\npage faults: %llu\n",
+              (unsigned long long)stats.allocations, (unsigned long long)stats.hits,
+              (unsigned long long)stats.recycled, (unsigned long long)stats.faults);
+    }
+    return result;
+  }
 
-  // if (opt_a1) {
-  //   processor.R[11] = a1;
-  // }
+  if (opt_fork_server) {
+    int result = run_fork_server(emulator, budget, opt_regdump);
+    emulator_destroy(emulator);
+    return result;
+  }
 
-  int simins = 0;
+  /* with -n, every hart gets its ID in a0, even when there is only one */
+  if (nharts != 0 && emulator_start_harts(emulator, nharts) != 0) {
+    fprintf(stderr, "The number of harts must be 1 to %d\n", EMULATOR_MAX_HARTS);
+    return -1;
+  }
 
-  if (opt_exit) {
-    /* simulate forever! */
-    while (1) {
-      execute(&processor, opt_interactive, opt_regdump);
+  /* --gdb hands the machine to a debugger; if it detaches, the run
+   * carries on with what is left of the budget */
+  if (gdb_address != NULL) {
+    if (emulator->nharts > 1) {
+      fprintf(stderr, "Debugging needs a single hart\n");
+      return -1;
     }
-  } else {
-    /* Either simulate for program instructions */
-    while (simins < prog_numins) {
-      execute(&processor, opt_interactive, opt_regdump);
-      simins++;
+    int session = gdb_serve(emulator, gdb_address);
+    if (session <= 0) {
+      int result = session < 0 ? -1 : print_status(stdout, emulator, processor->status);
+      emulator_destroy(emulator);
+      return result;
     }
+    budget = budget > processor->instret ? budget - processor->instret : 0;
+  }
+
+  if (arm_watches(&run.watches, emulator, watch_requests, nwatch_requests) != 0) {
+    return -1;
   }
-  return 0;
+  return run_machine(emulator, budget, opt_interactive, opt_regdump, opt_counters, checkpoint_at,
+                     checkpoint_file);
 }
@@ -2,13 +2,22 @@
 #define MIPS_H
 
 #include "types.h"
+#include "emulator.h"
 
-/* see part1.c */
-void decode_instruction(uint32_t instruction_bits);
+/* see part1.c; compressed is set when the C extension is on */
+void decode_instruction(uint32_t instruction_bits, int compressed);
 
 /* see part2.c */
-void execute_instruction(uint32_t instruction_bits, Processor* processor, Byte *memory);
+EmulatorStatus execute_instruction(uint32_t instruction_bits, Processor* processor,
+                                   Emulator *emulator);
+/* load() and store() touch nothing outside the MEMORY_SPACE bytes of guest
+   memory: a load from there reads 0 and a store is dropped. Instructions
+   check their addresses first with check_address(). */
 void store(Byte *memory, Address address, Alignment alignment, Word value);
 Word load(Byte *memory, Address address, Alignment alignment);
 
+/* Returns whether the length bytes at address are all in guest memory. If
+   not, stops the hart with EMULATOR_INVALID_ADDRESS and returns 0. */
+int check_address(Processor *, Address address, Word length);
+
 #endif
@@ -0,0 +1,354 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "types.h"
+#include "emulator.h"
+#include "jobs.h"
+#include "snapshot.h"
+#include "server.h"
+
+/* A program loaded and frozen once, then cloned for every job that runs
+   it. An image whose file changes is replaced, but kept until the daemon
+   stops since jobs may still be running on it. */
+typedef struct CachedImage {
+    char program[256];
+    struct timespec mtime;
+    off_t size;
+    Emulator *image;
+    int numins;
+    int stale;
+    struct CachedImage *next;
+} CachedImage;
+
+/* A worker's machine, kept between jobs. While jobs run the same image,
+   the machine is restored from a snapshot taken after it was cloned, which
+   copies back only the pages the last job wrote. */
+typedef struct {
+    Emulator *emulator;
+    EmulatorSnapshot *snapshot;
+    CachedImage *loaded;        /* the image the snapshot holds */
+} Machine;
+
+typedef struct {
+    int listener;
+    int stopping;
+    pthread_mutex_t lock;       /* guards images */
+    CachedImage *images;
+} Server;
+
+/* Returns the current image of program, loading it if needed, or NULL */
+static CachedImage *find_image(Server *server, const char *program) {
+    struct stat file;
+    CachedImage *cached;
+
+    if (stat(program, &file) != 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&server->lock);
+    for (cached = server->images; cached != NULL; cached = cached->next) {
+        if (!cached->stale && strcmp(cached->program, program) == 0) {
+            if (cached->size == file.st_size &&
+                cached->mtime.tv_sec == file.st_mtim.tv_sec &&
+                cached->mtime.tv_nsec == file.st_mtim.tv_nsec) {
+                pthread_mutex_unlock(&server->lock);
+                return cached;
+            }
+            cached->stale = 1;
+        }
+    }
+
+    cached = calloc(1, sizeof(CachedImage));
+    Emulator *image = emulator_create();
+    if (cached == NULL || image == NULL) {
+        goto fail;
+    }
+    cached->numins = emulator_load(image, program, image->harts[0].PC, 1);
+    if (cached->numins < 0 || emulator_freeze(image) != 0) {
+        goto fail;
+    }
+    snprintf(cached->program, sizeof(cached->program), "%s", program);
+    cached->mtime = file.st_mtim;
+    cached->size = file.st_size;
+    cached->image = image;
+    cached->next = server->images;
+    server->images = cached;
+    pthread_mutex_unlock(&server->lock);
+    return cached;
+
+fail:
+    pthread_mutex_unlock(&server->lock);
+    emulator_destroy(image);
+    free(cached);
+    return NULL;
+}
+
+static int send_all(int fd, const char *bytes, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        bytes += sent;
+        length -= sent;
+    }
+    return 0;
+}
+
+/* Writes for the FILE * a job prints to: each buffer flushed is one frame */
+static ssize_t write_frame(void *cookie, const char *bytes, size_t length) {
+    int fd = *(int *)cookie;
+    char header[32];
+    int header_length = snprintf(header, sizeof(header), "data %zu\n", length);
+    if (send_all(fd, header, header_length) != 0 || send_all(fd, bytes, length) != 0) {
+        return -1;
+    }
+    return length;
+}
+
+static int send_text(int fd, const char *text) {
+    return send_all(fd, text, strlen(text));
+}
+
+static int reply(int fd, const char *format, int value) {
+    char line[64];
+    int length = snprintf(line, sizeof(line), format, value);
+    return send_all(fd, line, length);
+}
+
+/* Returns the machine to the image's state. Returns 0, or -1 on failure. */
+static int prepare_machine(Machine *machine, CachedImage *cached) {
+    if (machine->loaded == cached && emulator_restore(machine->snapshot) >= 0) {
+        return 0;
+    }
+    emulator_snapshot_free(machine->snapshot);
+    machine->snapshot = NULL;
+    machine->loaded = NULL;
+    if (machine->emulator == NULL || emulator_reset(machine->emulator, cached->image) != 0) {
+        emulator_destroy(machine->emulator);
+        machine->emulator = emulator_clone(cached->image);
+        if (machine->emulator == NULL) {
+            return -1;
+        }
+    }
+    // without a snapshot the next job just resets the machine again
+    machine->snapshot = emulator_snapshot(machine->emulator);
+    if (machine->snapshot != NULL) {
+        machine->loaded = cached;
+    }
+    return 0;
+}
+
+/* Runs one request on the worker's machine */
+static int run_request(Server *server, int fd, FILE *out, char *request, Machine *machine) {
+    char program[256], budget[32] = "-", flags[16] = "-";
+    Job job = {"-", ""};
+    int fields = sscanf(request, "%255s %255s %255s %31s %15s", program, job.args,
+                        job.data_file, budget, flags);
+    if (fields < 1) {
+        return 0;
+    }
+    if (strcmp(job.data_file, "-") == 0) {
+        job.data_file[0] = '\0';
+    }
+
+    CachedImage *cached = find_image(server, program);
+    if (cached == NULL) {
+        return send_text(fd, "error cannot load the program\n");
+    }
+    if (prepare_machine(machine, cached) != 0) {
+        return send_text(fd, "error out of memory\n");
+    }
+    if (setup_job(machine->emulator, &job) != 0) {
+        return send_text(fd, "error cannot read the data file\n");
+    }
+
+    Double instructions = cached->numins;
+    if (strcmp(budget, "e") == 0) {
+        instructions = EMULATOR_FOREVER;
+    } else if (strcmp(budget, "-") != 0) {
+        instructions = strtoull(budget, NULL, 10);
+    }
+    int result = run_job(machine->emulator, instructions, out, strcmp(flags, "r") == 0);
+    if (fflush(out) != 0) {
+        return -1;
+    }
+    return reply(fd, "exit %d\n", result);
+}
+
+static void serve_connection(Server *server, int fd, Machine *machine) {
+    cookie_io_functions_t frames = {NULL, write_frame, NULL, NULL};
+    FILE *in = fdopen(dup(fd), "r");
+    FILE *out = fopencookie(&fd, "w", frames);
+    char request[1024];
+
+    if (in == NULL || out == NULL) {
+        goto done;
+    }
+    setvbuf(out, NULL, _IOFBF, 64 * 1024);
+    while (fgets(request, sizeof(request), in) != NULL) {
+        if (strncmp(request, "quit", 4) == 0) {
+            __atomic_store_n(&server->stopping, 1, __ATOMIC_RELEASE);
+            // wakes every worker blocked in accept()
+            shutdown(server->listener, SHUT_RDWR);
+            break;
+        }
+        if (run_request(server, fd, out, request, machine) != 0) {
+            break;
+        }
+    }
+
+done:
+    if (out != NULL) {
+        fclose(out);
+    }
+    if (in != NULL) {
+        fclose(in);
+    }
+}
+
+/* A worker serves one connection at a time, with its own machine */
+static void *serve_connections(void *arg) {
+    Server *server = arg;
+    Machine machine = {NULL, NULL, NULL};
+
+    while (!__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE)) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;
+        }
+        serve_connection(server, fd, &machine);
+        close(fd);
+    }
+    emulator_snapshot_free(machine.snapshot);
+    emulator_destroy(machine.emulator);
+    return NULL;
+}
+
+int serve(const char *path) {
+    Server server = {-1, 0, PTHREAD_MUTEX_INITIALIZER, NULL};
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    server.listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (server.listener < 0 ||
+        bind(server.listener, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server.listener, 64) != 0) {
+        fprintf(stderr, "Cannot listen on %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    /* a worker per CPU, but at least a few, since clients hold on to
+     * their connections */
+    long nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nworkers < 4) {
+        nworkers = 4;
+    }
+    pthread_t workers[nworkers];
+    int started;
+    for (started = 1; started < nworkers; started++) {
+        if (pthread_create(&workers[started], NULL, serve_connections, &server) != 0) {
+            break;
+        }
+    }
+    serve_connections(&server);
+    for (int i = 1; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    close(server.listener);
+    unlink(path);
+    while (server.images != NULL) {
+        CachedImage *cached = server.images;
+        server.images = cached->next;
+        emulator_destroy(cached->image);
+        free(cached);
+    }
+    return 0;
+}
+
+/* Connects to the daemon, waiting a little for one that is starting up */
+static int connect_daemon(const char *path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    for (int attempt = 0; attempt < 100; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+            return fd;
+        }
+        close(fd);
+        usleep(10000);
+    }
+    return -1;
+}
+
+int serve_client(const char *path) {
+    char request[1024], line[1024], buffer[4096];
+    int fd = connect_daemon(path);
+    int result = 0, code;
+    size_t length;
+
+    if (fd < 0) {
+        fprintf(stderr, "Cannot connect to %s\n", path);
+        return -1;
+    }
+    FILE *in = fdopen(fd, "r");
+    while (fgets(request, sizeof(request), stdin) != NULL) {
+        if (request[strspn(request, " \t\n")] == '\0' || request[0] == '#') {
+            continue;
+        }
+        if (send_all(fd, request, strlen(request)) != 0) {
+            result = -1;
+            break;
+        }
+        if (strncmp(request, "quit", 4) == 0) {
+            break;
+        }
+        // copy the frames until the run's exit code
+        while (fgets(line, sizeof(line), in) != NULL) {
+            if (sscanf(line, "data %zu", &length) == 1) {
+                while (length > 0) {
+                    size_t chunk = length < sizeof(buffer) ? length : sizeof(buffer);
+                    if (fread(buffer, 1, chunk, in) != chunk) {
+                        break;
+                    }
+                    fwrite(buffer, 1, chunk, stdout);
+                    length -= chunk;
+                }
+            } else if (sscanf(line, "exit %d", &code) == 1) {
+                result |= code;
+                break;
+            } else {
+                fprintf(stderr, "%s", line);
+                result = -1;
+                break;
+            }
+        }
+    }
+    fclose(in);
+    return result;
+}
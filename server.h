@@ -0,0 +1,29 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+/* riscv --serve keeps loaded programs and guest memories warm in a daemon
+   and runs jobs sent over a Unix domain socket, so a job costs no process
+   start or program load. A connection carries any number of requests, one
+   per line:
+
+       PROGRAM [ARGS [DATA [BUDGET [FLAGS]]]]
+
+   ARGS are the -a values and DATA a data file for -s, "-" for none.
+   BUDGET is the number of instructions to run, "-" for as many as the
+   program has lines and "e" to run until the guest exits, as -e does.
+   FLAGS is "r" to trace the registers as -r does, or "-". The reply is
+   what the run prints, as any number of "data LENGTH\n" frames each
+   followed by LENGTH bytes, and then "exit CODE\n" with the simulator's
+   exit code, or a single "error MESSAGE\n". A "quit" line stops the
+   daemon. Program and data paths are relative to the daemon's directory. */
+
+/* Listens on path until a client sends quit. Returns 0, or -1 if the
+   socket cannot be set up. */
+int serve(const char *path);
+
+/* Sends the request lines on stdin to the daemon at path, one at a time,
+   and copies what each run printed to stdout. Returns 0, or -1 if any job
+   failed or the daemon cannot be reached. */
+int serve_client(const char *path);
+
+#endif
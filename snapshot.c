@@ -0,0 +1,68 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "types.h"
+#include "emulator.h"
+#include "memory.h"
+#include "snapshot.h"
+
+EmulatorSnapshot *emulator_snapshot(Emulator *emulator) {
+    EmulatorSnapshot *snapshot = malloc(sizeof(EmulatorSnapshot));
+    if (snapshot == NULL) {
+        return NULL;
+    }
+    /* the copy is anonymous memory, so pages that are all zero cost
+     * nothing until they are needed */
+    snapshot->memory = mmap(NULL, MEMORY_SPACE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (snapshot->memory == MAP_FAILED) {
+        free(snapshot);
+        return NULL;
+    }
+    for (size_t offset = 0; offset < MEMORY_SPACE; offset += PAGE_SIZE) {
+        const Byte *bytes = emulator->memory + offset;
+        if (!memory_is_zero_page(bytes)) {
+            memcpy(snapshot->memory + offset, bytes, PAGE_SIZE);
+        }
+    }
+
+    snapshot->emulator = emulator;
+    memcpy(snapshot->harts, emulator->harts, sizeof(snapshot->harts));
+    snapshot->nharts = emulator->nharts;
+    if (memory_track(&snapshot->tracker, emulator->memory) != 0) {
+        munmap(snapshot->memory, MEMORY_SPACE);
+        free(snapshot);
+        return NULL;
+    }
+    return snapshot;
+}
+
+int emulator_restore(EmulatorSnapshot *snapshot) {
+    Emulator *emulator = snapshot->emulator;
+    int copied = 0;
+
+    for (unsigned page = 0; page < MEMORY_PAGES; page++) {
+        if (memory_is_dirty(&snapshot->tracker, page)) {
+            size_t offset = (size_t)page << PAGE_SHIFT;
+            memcpy(emulator->memory + offset, snapshot->memory + offset, PAGE_SIZE);
+            copied++;
+        }
+    }
+    if (memory_clean(&snapshot->tracker) != 0) {
+        return -1;
+    }
+
+    memcpy(emulator->harts, snapshot->harts, sizeof(snapshot->harts));
+    emulator->nharts = snapshot->nharts;
+    emulator->stop = 0;
+    emulator->fault = 0;
+    return copied;
+}
+
+void emulator_snapshot_free(EmulatorSnapshot *snapshot) {
+    if (snapshot != NULL) {
+        memory_untrack(&snapshot->tracker);
+        munmap(snapshot->memory, MEMORY_SPACE);
+        free(snapshot);
+    }
+}
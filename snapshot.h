@@ -0,0 +1,31 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "types.h"
+#include "emulator.h"
+#include "memory.h"
+
+/* The state of an emulator at one point, usually just after loading, that
+   it can be returned to any number of times. Taking the snapshot starts
+   tracking which pages the guest writes, so a restore copies back only
+   those. */
+typedef struct {
+    Emulator *emulator;
+    Processor harts[EMULATOR_MAX_HARTS];
+    int nharts;
+    Byte *memory;               /* the guest memory when taken */
+    MemoryTracker tracker;
+} EmulatorSnapshot;
+
+/* Takes a snapshot of emulator. Returns NULL on failure. The snapshot
+   must be freed before the emulator is reset or destroyed. */
+EmulatorSnapshot *emulator_snapshot(Emulator *);
+
+/* Returns the emulator's harts and memory to the snapshot. Returns the
+   number of pages copied back, or -1 on failure. */
+int emulator_restore(EmulatorSnapshot *);
+
+/* Stops tracking the emulator and frees the snapshot */
+void emulator_snapshot_free(EmulatorSnapshot *);
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "utils.h"
 #include "types.h"
+#include "custom.h"
 
 void test_sign_extend_number();
 void test_parse_instruction_rtype();
@@ -12,6 +13,11 @@ void test_parse_instruction_stype();
 void test_parse_instruction_sbtype();
 void test_parse_instruction_ujtype();
 void test_parse_instruction_utype();
+void test_expand_compressed();
+void test_parse_instruction_vector();
+void test_parse_instruction_csr();
+void test_parse_instruction_atomic();
+void test_register_custom_instruction();
 
 int main(int arc, char **argv) {
     CU_pSuite pSuite1 = NULL;
@@ -53,6 +59,26 @@ int main(int arc, char **argv) {
         goto exit;
     }
 
+    if (!CU_add_test(pSuite1, "test_expand_compressed", test_expand_compressed)) {
+        goto exit;
+    }
+
+    if (!CU_add_test(pSuite1, "test_parse_instruction_vector", test_parse_instruction_vector)) {
+        goto exit;
+    }
+
+    if (!CU_add_test(pSuite1, "test_parse_instruction_csr", test_parse_instruction_csr)) {
+        goto exit;
+    }
+
+    if (!CU_add_test(pSuite1, "test_parse_instruction_atomic", test_parse_instruction_atomic)) {
+        goto exit;
+    }
+
+    if (!CU_add_test(pSuite1, "test_register_custom_instruction", test_register_custom_instruction)) {
+        goto exit;
+    }
+
 
 
     CU_basic_set_mode(CU_BRM_VERBOSE);
@@ -130,3 +156,126 @@ void test_parse_instruction_ujtype() {
     CU_ASSERT_EQUAL(inst.ujtype.rd, 1);
     CU_ASSERT_EQUAL(inst.ujtype.imm, 0);
 }
+
+void test_expand_compressed() {
+    const char *name;
+    CU_ASSERT_TRUE(is_compressed(0x040d, 1));
+    CU_ASSERT_FALSE(is_compressed(0x040d, 0));
+    CU_ASSERT_FALSE(is_compressed(0x00a50313, 1));
+    // c.addi x8, 3 -> addi x8, x8, 3
+    CU_ASSERT_EQUAL(expand_compressed(0x040d, &name), 0x00340413);
+    CU_ASSERT_STRING_EQUAL(name, "c.addi");
+    // c.lw x14, 0(x13) -> lw x14, 0(x13)
+    CU_ASSERT_EQUAL(expand_compressed(0x4298, &name), 0x0006a703);
+    // c.swsp x11, 4(x2) -> sw x11, 4(x2)
+    CU_ASSERT_EQUAL(expand_compressed(0xc22e, &name), 0x00b12223);
+    // c.bnez x15, -2 -> bne x15, x0, -2
+    CU_ASSERT_EQUAL(expand_compressed(0xfffd, &name), 0xfe079fe3);
+    // c.j 4 -> jal x0, 4
+    CU_ASSERT_EQUAL(expand_compressed(0xa011, &name), 0x0040006f);
+    // c.jr x1 -> jalr x0, 0(x1)
+    CU_ASSERT_EQUAL(expand_compressed(0x8082, &name), 0x00008067);
+    CU_ASSERT_STRING_EQUAL(name, "c.jr");
+    // the all-zero parcel is defined to be illegal
+    CU_ASSERT_EQUAL(expand_compressed(0x0000, &name), 0);
+}
+
+void test_parse_instruction_vector() {
+    Instruction inst;
+    // vredmax.vs v3, v1, v2
+    inst = parse_instruction(0x1e1121d7);
+    CU_ASSERT_EQUAL(inst.varith.opcode, 0x57);
+    CU_ASSERT_EQUAL(inst.varith.vd, 3);
+    CU_ASSERT_EQUAL(inst.varith.funct3, 0x2);
+    CU_ASSERT_EQUAL(inst.varith.vs1, 2);
+    CU_ASSERT_EQUAL(inst.varith.vs2, 1);
+    CU_ASSERT_EQUAL(inst.varith.vm, 1);
+    CU_ASSERT_EQUAL(inst.varith.funct6, 0x07);
+    CU_ASSERT_STRING_EQUAL(get_vector_name(inst), "vredmax.vs");
+    // vle32.v v1, (x11), v0.t
+    inst = parse_instruction(0x0005e087);
+    CU_ASSERT_EQUAL(inst.vmem.opcode, 0x07);
+    CU_ASSERT_EQUAL(inst.vmem.vd, 1);
+    CU_ASSERT_EQUAL(inst.vmem.rs1, 11);
+    CU_ASSERT_EQUAL(inst.vmem.vm, 0);
+    CU_ASSERT_EQUAL(inst.vmem.mop, 0);
+    CU_ASSERT_EQUAL(get_vector_width(inst), 4);
+}
+
+void test_parse_instruction_csr() {
+    Instruction inst;
+    Processor processor = {0};
+    // csrrs x7, instret, x0
+    inst = parse_instruction(0xc02023f3);
+    CU_ASSERT_EQUAL(inst.itype.opcode, 0x73);
+    CU_ASSERT_EQUAL(inst.itype.rd, 7);
+    CU_ASSERT_EQUAL(inst.itype.funct3, 0x2);
+    CU_ASSERT_EQUAL(inst.itype.rs1, 0);
+    CU_ASSERT_EQUAL(inst.itype.imm, CSR_INSTRET);
+    CU_ASSERT_STRING_EQUAL(get_csr_name(inst.itype.imm), "instret");
+    CU_ASSERT_PTR_NULL(get_csr_name(0x300));
+    // cycle counts stalls on top of retired instructions
+    processor.instret = 95;
+    processor.stall = 5;
+    CU_ASSERT_EQUAL(get_cycle_count(&processor), 100);
+    CU_ASSERT_EQUAL(get_time_count(&processor), 100 / TIME_DIVISOR);
+}
+
+void test_parse_instruction_atomic() {
+    Instruction inst;
+    // lr.w.aq x7, (x8)
+    inst = parse_instruction(0x140423af);
+    CU_ASSERT_EQUAL(inst.atype.opcode, 0x2f);
+    CU_ASSERT_EQUAL(inst.atype.rd, 7);
+    CU_ASSERT_EQUAL(inst.atype.rs1, 8);
+    CU_ASSERT_EQUAL(inst.atype.funct5, 0x02);
+    CU_ASSERT_EQUAL(inst.atype.aq, 1);
+    CU_ASSERT_EQUAL(inst.atype.rl, 0);
+    CU_ASSERT_STRING_EQUAL(get_amo_name(inst), "lr.w");
+    CU_ASSERT_STRING_EQUAL(get_amo_ordering(inst), ".aq");
+    // amoadd.w.rl x0, x6, (x5)
+    inst = parse_instruction(0x0262a02f);
+    CU_ASSERT_EQUAL(inst.atype.rs2, 6);
+    CU_ASSERT_STRING_EQUAL(get_amo_name(inst), "amoadd.w");
+    CU_ASSERT_STRING_EQUAL(get_amo_ordering(inst), ".rl");
+    // lr.w with a source register is reserved
+    inst = parse_instruction(0x146423af);
+    CU_ASSERT_PTR_NULL(get_amo_name(inst));
+}
+
+static void execute_nothing(Instruction instruction, Processor *processor, Byte *memory) {
+}
+
+static int match_nothing(Instruction instruction) {
+    return 0;
+}
+
+void test_register_custom_instruction() {
+    static const CustomInstruction taken = {"taken", 0x5b, 0x1, 0x05, NULL, NULL, execute_nothing};
+    static const CustomInstruction same = {"same", 0x5b, 0x1, 0x05, NULL, NULL, execute_nothing};
+    static const CustomInstruction any7 = {"any7", 0x5b, 0x1, CUSTOM_ANY, NULL, NULL, execute_nothing};
+    static const CustomInstruction any3 = {"any3", 0x5b, CUSTOM_ANY, 0x05, NULL, NULL, execute_nothing};
+    static const CustomInstruction other7 = {"other7", 0x5b, 0x1, 0x06, NULL, NULL, execute_nothing};
+    static const CustomInstruction other3 = {"other3", 0x5b, 0x2, 0x05, NULL, NULL, execute_nothing};
+    static const CustomInstruction builtin = {"builtin", 0x2a, 0x2, 0x01, NULL, NULL, execute_nothing};
+    static const CustomInstruction matched = {"matched", 0x5b, 0x3, CUSTOM_ANY, match_nothing, NULL, execute_nothing};
+    static const CustomInstruction matched2 = {"matched2", 0x5b, 0x3, 0x05, match_nothing, NULL, execute_nothing};
+    static const CustomInstruction unmatched = {"unmatched", 0x5b, 0x3, 0x07, NULL, NULL, execute_nothing};
+    static const CustomInstruction opcode = {"opcode", 0x33, 0x1, 0x05, NULL, NULL, execute_nothing};
+
+    CU_ASSERT_EQUAL(register_custom_instruction(&taken), 0);
+    // equal funct7, or CUSTOM_ANY on either side, overlaps
+    CU_ASSERT_EQUAL(register_custom_instruction(&same), -1);
+    CU_ASSERT_EQUAL(register_custom_instruction(&any7), -1);
+    CU_ASSERT_EQUAL(register_custom_instruction(&any3), -1);
+    CU_ASSERT_EQUAL(register_custom_instruction(&builtin), -1);
+    CU_ASSERT_EQUAL(register_custom_instruction(&other7), 0);
+    CU_ASSERT_EQUAL(register_custom_instruction(&other3), 0);
+    // encodings narrowed with match() may share, but not with one that is not
+    CU_ASSERT_EQUAL(register_custom_instruction(&matched), 0);
+    CU_ASSERT_EQUAL(register_custom_instruction(&matched2), 0);
+    CU_ASSERT_EQUAL(register_custom_instruction(&unmatched), -1);
+    CU_ASSERT_EQUAL(register_custom_instruction(&opcode), -1);
+    // a rejected registration leaves the table as it was
+    CU_ASSERT_PTR_EQUAL(find_custom_instruction(parse_instruction(0x0a0090db)), &taken);
+}
@@ -0,0 +1,233 @@
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "emulator.h"
+#include "memory.h"
+#include "timeline.h"
+
+/* One save: the hart, and in page_versions the pages written since the
+   save before it */
+typedef struct {
+    Double time;
+    Processor hart;
+} Save;
+
+/* A page's contents at each save where it had changed */
+typedef struct {
+    int save;
+    Byte *bytes;
+} PageVersion;
+
+struct Timeline {
+    Emulator *emulator;
+    Double interval;
+    Double start;               /* the hart's instret at time 0 */
+    Double frontier;            /* the furthest time reached */
+    Save *saves;
+    int nsaves;
+    int capacity;
+    PageVersion *versions[MEMORY_PAGES];
+    int nversions[MEMORY_PAGES];
+    MemoryTracker tracker;
+};
+
+static void discard_output(void *opaque, const char *text, size_t length) {
+    (void)opaque;
+    (void)text;
+    (void)length;
+}
+
+Double timeline_now(const Timeline *timeline) {
+    return timeline->emulator->harts[0].instret - timeline->start;
+}
+
+/* Keeps the page as it is now as its version for the newest save */
+static int save_page(Timeline *timeline, unsigned page) {
+    PageVersion *versions = realloc(timeline->versions[page],
+                                    (timeline->nversions[page] + 1) * sizeof(PageVersion));
+    if (versions == NULL) {
+        return -1;
+    }
+    timeline->versions[page] = versions;
+    Byte *bytes = malloc(PAGE_SIZE);
+    if (bytes == NULL) {
+        return -1;
+    }
+    memcpy(bytes, timeline->emulator->memory + ((size_t)page << PAGE_SHIFT), PAGE_SIZE);
+    versions[timeline->nversions[page]].save = timeline->nsaves - 1;
+    versions[timeline->nversions[page]].bytes = bytes;
+    timeline->nversions[page]++;
+    return 0;
+}
+
+/* Saves the machine at the current time; the first save keeps every page
+   in use, later ones the pages written since the save before */
+static int save(Timeline *timeline) {
+    if (timeline->nsaves == timeline->capacity) {
+        int capacity = timeline->capacity ? timeline->capacity * 2 : 16;
+        Save *saves = realloc(timeline->saves, capacity * sizeof(Save));
+        if (saves == NULL) {
+            return -1;
+        }
+        timeline->saves = saves;
+        timeline->capacity = capacity;
+    }
+    Save *last = &timeline->saves[timeline->nsaves++];
+    last->time = timeline_now(timeline);
+    last->hart = timeline->emulator->harts[0];
+
+    for (unsigned page = 0; page < MEMORY_PAGES; page++) {
+        int changed = timeline->nsaves == 1
+                          ? !memory_is_zero_page(timeline->emulator->memory +
+                                                 ((size_t)page << PAGE_SHIFT))
+                          : memory_is_dirty(&timeline->tracker, page);
+        if (changed && save_page(timeline, page) != 0) {
+            return -1;
+        }
+    }
+    return memory_clean(&timeline->tracker);
+}
+
+/* Puts the machine back to save i: every page that has ever changed gets
+   its newest version up to i, or zero if it had none yet */
+static void restore(Timeline *timeline, int i) {
+    Emulator *emulator = timeline->emulator;
+    for (unsigned page = 0; page < MEMORY_PAGES; page++) {
+        if (timeline->nversions[page] == 0 && !memory_is_dirty(&timeline->tracker, page)) {
+            continue;
+        }
+        Byte *target = emulator->memory + ((size_t)page << PAGE_SHIFT);
+        int v = timeline->nversions[page] - 1;
+        while (v >= 0 && timeline->versions[page][v].save > i) {
+            v--;
+        }
+        if (v >= 0) {
+            memcpy(target, timeline->versions[page][v].bytes, PAGE_SIZE);
+        } else {
+            memset(target, 0, PAGE_SIZE);
+        }
+    }
+    memory_clean(&timeline->tracker);
+    emulator->harts[0] = timeline->saves[i].hart;
+    emulator->stop = 0;
+}
+
+Timeline *timeline_create(Emulator *emulator, Double interval) {
+    if (emulator->nharts != 1 || interval == 0) {
+        return NULL;
+    }
+    Timeline *timeline = calloc(1, sizeof(Timeline));
+    if (timeline == NULL) {
+        return NULL;
+    }
+    timeline->emulator = emulator;
+    timeline->interval = interval;
+    timeline->start = emulator->harts[0].instret;
+    if (memory_track(&timeline->tracker, emulator->memory) != 0) {
+        free(timeline);
+        return NULL;
+    }
+    if (save(timeline) != 0) {
+        timeline_free(timeline);
+        return NULL;
+    }
+    return timeline;
+}
+
+void timeline_free(Timeline *timeline) {
+    if (timeline == NULL) {
+        return;
+    }
+    memory_untrack(&timeline->tracker);
+    for (unsigned page = 0; page < MEMORY_PAGES; page++) {
+        for (int v = 0; v < timeline->nversions[page]; v++) {
+            free(timeline->versions[page][v].bytes);
+        }
+        free(timeline->versions[page]);
+    }
+    free(timeline->saves);
+    free(timeline);
+}
+
+/* Runs forward to time k, saving at each interval past the newest save.
+   Output is dropped for instructions that already ran once. */
+static EmulatorStatus advance(Timeline *timeline, Double k) {
+    Emulator *emulator = timeline->emulator;
+    EmulatorOutput output = emulator->output;
+    EmulatorStatus status = EMULATOR_RUNNING;
+
+    while (status == EMULATOR_RUNNING && timeline_now(timeline) < k) {
+        Double now = timeline_now(timeline);
+        Double stop = k;
+        Double newest = timeline->saves[timeline->nsaves - 1].time;
+        if (now >= newest && newest + timeline->interval < stop) {
+            stop = newest + timeline->interval;
+        }
+        if (now < timeline->frontier) {
+            if (timeline->frontier < stop) {
+                stop = timeline->frontier;
+            }
+            emulator->output = discard_output;
+        }
+        status = emulator_run(emulator, stop - now, NULL);
+        emulator->output = output;
+
+        now = timeline_now(timeline);
+        if (now > timeline->frontier) {
+            timeline->frontier = now;
+        }
+        if (status == EMULATOR_RUNNING && now == newest + timeline->interval && save(timeline) != 0) {
+            // without the save, going back replays from further away
+            timeline->interval = EMULATOR_FOREVER;
+        }
+    }
+    return status;
+}
+
+/* The newest save at or before time k */
+static int save_before(const Timeline *timeline, Double k) {
+    int i = timeline->nsaves - 1;
+    while (i > 0 && timeline->saves[i].time > k) {
+        i--;
+    }
+    return i;
+}
+
+EmulatorStatus timeline_goto(Timeline *timeline, Double k) {
+    Double now = timeline_now(timeline);
+    int i = save_before(timeline, k);
+    /* go back to a save unless k is ahead and no save lies between */
+    if (k < now || timeline->saves[i].time > now) {
+        restore(timeline, i);
+    }
+    return advance(timeline, k);
+}
+
+int timeline_reverse_continue(Timeline *timeline, Address pc) {
+    Emulator *emulator = timeline->emulator;
+    Double now = timeline_now(timeline);
+
+    /* search the intervals from the newest back, replaying each one step
+     * at a time and keeping the last time the PC matched */
+    for (int i = save_before(timeline, now); i >= 0; i--) {
+        Double end = i + 1 < timeline->nsaves && timeline->saves[i + 1].time < now
+                         ? timeline->saves[i + 1].time
+                         : now;
+        Double found = EMULATOR_FOREVER;
+        restore(timeline, i);
+        for (Double t = timeline->saves[i].time; t < end; t++) {
+            if (emulator->harts[0].PC == pc) {
+                found = t;
+            }
+            if (advance(timeline, t + 1) != EMULATOR_RUNNING) {
+                break;
+            }
+        }
+        if (found != EMULATOR_FOREVER) {
+            timeline_goto(timeline, found);
+            return 1;
+        }
+    }
+    timeline_goto(timeline, 0);
+    return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "types.h"
+#include "emulator.h"
+
+/* Lets a single-hart machine move back as well as forward. Going forward
+   saves the harts and the pages written since the last save every
+   interval instructions. Going back restores the nearest save at or
+   before the target and runs forward to it again, so any move costs at
+   most one interval of execution. Guest output is only printed the first
+   time an instruction runs. Instructions are counted from when the
+   timeline was created. */
+typedef struct Timeline Timeline;
+
+/* Starts recording; the emulator must have one hart and must not be
+   snapshotted (see snapshot.h) while the timeline exists. Returns NULL on
+   failure. */
+Timeline *timeline_create(Emulator *, Double interval);
+void timeline_free(Timeline *);
+
+/* The number of instructions retired since the start */
+Double timeline_now(const Timeline *);
+
+/* Runs forward, or restores and replays, until time k. Returns the status
+   the machine stopped with if it stops on the way, else EMULATOR_RUNNING. */
+EmulatorStatus timeline_goto(Timeline *, Double k);
+
+/* Goes back to the last time before now that the PC was pc, or to the
+   start if it never was. Returns 1 if pc was found. Unlike a move, this
+   replays every interval it searches one instruction at a time, so it
+   costs time in proportion to the whole distance back to the match (or to
+   the start), not just one interval. */
+int timeline_reverse_continue(Timeline *, Address pc);
+
+#endif
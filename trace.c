@@ -0,0 +1,969 @@
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "types.h"
+#include "trace.h"
+
+#define TRACE_MAGIC "RVTB"
+#define TRACE_VERSION 2
+#define TRACE_INDEX_MAGIC "RVTINDEX"
+
+/* Records are gathered here and written out in large blocks */
+#define BUFFER_SIZE (1 << 20)
+
+/* The longest step record is the text, with the line that numbers it; a
+   binary one has a head and two more varints of up to 10 bytes, and 32
+   register changes of up to 5 */
+#define MAX_STEP (TRACE_TEXT_SIZE + 64)
+
+/* One instruction's text, with the digits of register i at
+   TEMPLATE_DIGITS(i) */
+#define TEMPLATE_DIGITS(i) ((i) / 4 * 53 + (i) % 4 * 13 + 4)
+
+static char text_template[TRACE_TEXT_SIZE];
+static uint16_t hex_pairs[256];             /* the two digits of a byte */
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void build_tables(void) {
+    char *out = text_template;
+    for (int i = 0; i < 32; i++) {
+        out += sprintf(out, "r%2d=%08x ", i, 0);
+        if (i % 4 == 3) {
+            *out++ = '\n';
+        }
+    }
+    *out = '\n';
+    for (int i = 0; i < 256; i++) {
+        char digits[2] = {"0123456789abcdef"[i >> 4], "0123456789abcdef"[i & 0xF]};
+        memcpy(&hex_pairs[i], digits, 2);
+    }
+}
+
+size_t trace_format_registers(char *out, const Register *R) {
+    pthread_once(&tables_once, build_tables);
+    memcpy(out, text_template, TRACE_TEXT_SIZE);
+    for (int i = 0; i < 32; i++) {
+        // all eight digits go out in one store, most significant first on
+        // a little-endian host
+        uint64_t digits = (uint64_t)hex_pairs[R[i] >> 24] |
+                          (uint64_t)hex_pairs[(R[i] >> 16) & 0xFF] << 16 |
+                          (uint64_t)hex_pairs[(R[i] >> 8) & 0xFF] << 32 |
+                          (uint64_t)hex_pairs[R[i] & 0xFF] << 48;
+        memcpy(out + TEMPLATE_DIGITS(i), &digits, 8);
+    }
+    return TRACE_TEXT_SIZE;
+}
+
+/* An asynchronous sink hands its steps and text to the writer thread as
+   records in a ring. Text longer than a record goes in several, the first
+   of which gives the length of all of it. */
+enum { RECORD_STEP, RECORD_TEXT, RECORD_MORE_TEXT };
+
+typedef struct {
+    Word kind;
+    Word length;                /* of the text in this record */
+    Double index;               /* a step's, or the length of all the text */
+    Register pc;
+    union {
+        Register R[32];
+        char text[32 * sizeof(Register)];
+    };
+} Record;
+
+/* 2.5 MB of records; the executor only blocks once they are all waiting */
+#define RING_SLOTS (1 << 14)
+
+/* A sleeping thread is woken only once there is this much for it to do,
+   so that on a busy host the two do not take turns a record at a time */
+#define WAKE_BATCH (RING_SLOTS / 4)
+
+/* Single producer, single consumer. Each side only writes its own index,
+   and sleeps on a futex when it finds the ring full or empty, with a flag
+   that tells the other side to wake it. */
+typedef struct {
+    Record *records;
+    uint32_t head __attribute__((aligned(64)));     /* records added */
+    int writer_waiting;
+    uint32_t signal;            /* bumped to wake the writer */
+    int closing;
+    uint32_t tail __attribute__((aligned(64)));     /* records written */
+    int executor_waiting;
+
+    /* only the executor touches these */
+    Double added __attribute__((aligned(64)));
+    Double stalls;
+    Double peak;
+    Double occupancy;           /* summed over the records added */
+    pthread_t writer;
+} Ring;
+
+/* An entry of the index at the end of a binary trace */
+typedef struct {
+    Double first;               /* the index of the chunk's first step */
+    Double offset;              /* of its first record in the file */
+
+    /* what its first step is relative to */
+    Double next;
+    Register pc;
+    Register R[32];
+} TraceChunk;
+
+/* The last bytes of a binary trace */
+typedef struct {
+    Double chunks;
+    Double offset;              /* of the first entry */
+    char magic[8];
+} TraceFooter;
+
+/* How a run can differ from the trace it is expected to print */
+enum { MATCHING, WRONG_REGISTERS, NO_STEP, WRONG_TEXT, TRACE_GOES_ON };
+
+/* The text trace an expecting sink compares the run with, mapped */
+typedef struct {
+    char *path;
+    const char *data, *end;
+    const char *at;             /* where the next of the run's text is */
+    Double steps;               /* that matched */
+
+    /* the first difference */
+    int difference;
+    const char *where;          /* in the trace */
+    Double index;
+    Register pc;
+    Register want[32], got[32];
+    char text[128];             /* the run's line that differs */
+} Expect;
+
+struct TraceSink {
+    int fd;
+    TraceFormat format;
+    int error;
+    FILE *stream;
+    Byte *buffer;
+    size_t used;
+
+    /* what the previous step left, which the next one is relative to */
+    Register R[32];
+    Register pc;
+    Double next;
+
+    /* the index of a binary trace */
+    Double written;             /* bytes flushed so far */
+    Double chunk_end;           /* the step that starts a new chunk */
+    TraceChunk *chunks;
+    size_t nchunks, chunk_slots;
+
+    Ring *ring;                 /* for an asynchronous sink */
+    Expect *expect;             /* for an expecting sink */
+
+    Word registers;             /* that steps record */
+    int numbered;
+};
+
+static void futex_wait(uint32_t *word, uint32_t value) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/* Writes out the buffer, and then extra if there is any, in one call */
+static void flush(TraceSink *sink, const void *extra, size_t length) {
+    struct iovec parts[2] = {{sink->buffer, sink->used}, {(void *)extra, length}};
+    int first = sink->used == 0;
+
+    sink->written += sink->used + length;
+    while (first < 2) {
+        ssize_t written = writev(sink->fd, parts + first, 2 - first);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            sink->error = 1;
+            break;
+        }
+        for (; first < 2 && (size_t)written >= parts[first].iov_len; first++) {
+            written -= parts[first].iov_len;
+        }
+        if (first < 2) {
+            parts[first].iov_base = (Byte *)parts[first].iov_base + written;
+            parts[first].iov_len -= written;
+        }
+    }
+    sink->used = 0;
+}
+
+static Byte *put_varint(Byte *out, Double value) {
+    while (value >= 0x80) {
+        *out++ = (Byte)value | 0x80;
+        value >>= 7;
+    }
+    *out++ = (Byte)value;
+    return out;
+}
+
+static Word zigzag(Word value) {
+    return (value << 1) ^ (Word)((sWord)value >> 31);
+}
+
+static Word unzigzag(Word value) {
+    return (value >> 1) ^ -(value & 1);
+}
+
+/* Adds an entry for a chunk that starts with the step at index */
+static void start_chunk(TraceSink *sink, Double index) {
+    if (sink->nchunks == sink->chunk_slots) {
+        size_t slots = sink->chunk_slots ? 2 * sink->chunk_slots : 64;
+        TraceChunk *chunks = realloc(sink->chunks, slots * sizeof(TraceChunk));
+        if (chunks == NULL) {
+            sink->error = 1;
+            return;
+        }
+        sink->chunks = chunks;
+        sink->chunk_slots = slots;
+    }
+    TraceChunk *chunk = &sink->chunks[sink->nchunks++];
+    chunk->first = index;
+    chunk->offset = sink->written + sink->used;
+    chunk->next = sink->next;
+    chunk->pc = sink->pc;
+    memcpy(chunk->R, sink->R, sizeof(chunk->R));
+    sink->chunk_end = (index / TRACE_CHUNK + 1) * TRACE_CHUNK;
+}
+
+/* Formats some of the registers, four to a line as -r prints them */
+static size_t format_some_registers(char *out, const Register *R, Word registers) {
+    char *start = out;
+    int count = 0;
+    for (Word left = registers; left != 0; left &= left - 1) {
+        int i = __builtin_ctz(left);
+        out += sprintf(out, "r%2d=%08x ", i, R[i]);
+        if (++count % 4 == 0) {
+            *out++ = '\n';
+        }
+    }
+    if (count % 4 != 0) {
+        *out++ = '\n';
+    }
+    *out++ = '\n';
+    return out - start;
+}
+
+static void record_step(TraceSink *sink, Double index, Register pc, const Register *R) {
+    Word mask = 0;
+    if (BUFFER_SIZE - sink->used < MAX_STEP) {
+        flush(sink, NULL, 0);
+    }
+    if (sink->format == TRACE_TEXT) {
+        char *out = (char *)sink->buffer + sink->used;
+        if (sink->numbered) {
+            out += sprintf(out, "@%llu pc=%08x\n", (unsigned long long)index, pc);
+        }
+        if (sink->registers == TRACE_ALL_REGISTERS) {
+            out += trace_format_registers(out, R);
+        } else {
+            out += format_some_registers(out, R, sink->registers);
+        }
+        sink->used = out - (char *)sink->buffer;
+        return;
+    }
+    if (index >= sink->chunk_end) {
+        start_chunk(sink, index);
+    }
+
+    for (int i = 0; i < 32; i++) {
+        mask |= (Word)(R[i] != sink->R[i]) << i;
+    }
+    // the registers left out stay zero
+    mask &= sink->registers;
+
+    Byte *out = sink->buffer + sink->used;
+    out = put_varint(out, (Double)mask << 1 | 1);
+    out = put_varint(out, index - sink->next);
+    out = put_varint(out, zigzag(pc - (sink->pc + 4)));
+    for (Word changed = mask; changed != 0; changed &= changed - 1) {
+        int i = __builtin_ctz(changed);
+        out = put_varint(out, zigzag(R[i] - sink->R[i]));
+        sink->R[i] = R[i];
+    }
+    sink->used = out - sink->buffer;
+    sink->pc = pc;
+    sink->next = index + 1;
+}
+
+/* Starts a piece of text of length bytes, which append() adds */
+static void record_text(TraceSink *sink, Double length) {
+    if (sink->format == TRACE_BINARY) {
+        if (BUFFER_SIZE - sink->used < 10) {
+            flush(sink, NULL, 0);
+        }
+        sink->used = put_varint(sink->buffer + sink->used, length << 1) - sink->buffer;
+    }
+}
+
+static void append(TraceSink *sink, const void *text, size_t length) {
+    if (length > BUFFER_SIZE - sink->used) {
+        // too long to buffer: goes straight out behind what is
+        if (length >= BUFFER_SIZE) {
+            flush(sink, text, length);
+            return;
+        }
+        flush(sink, NULL, 0);
+    }
+    memcpy(sink->buffer + sink->used, text, length);
+    sink->used += length;
+}
+
+static void *write_records(void *opaque) {
+    TraceSink *sink = opaque;
+    Ring *ring = sink->ring;
+    uint32_t tail = ring->tail;
+
+    for (;;) {
+        uint32_t signal = __atomic_load_n(&ring->signal, __ATOMIC_ACQUIRE);
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (__atomic_load_n(&ring->closing, __ATOMIC_ACQUIRE)) {
+                break;
+            }
+            __atomic_store_n(&ring->writer_waiting, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == tail &&
+                !__atomic_load_n(&ring->closing, __ATOMIC_SEQ_CST)) {
+                futex_wait(&ring->signal, signal);
+            }
+            __atomic_store_n(&ring->writer_waiting, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        for (; tail != head; tail++) {
+            Record *record = &ring->records[tail % RING_SLOTS];
+            if (record->kind == RECORD_STEP) {
+                record_step(sink, record->index, record->pc, record->R);
+            } else {
+                if (record->kind == RECORD_TEXT) {
+                    record_text(sink, record->index);
+                }
+                append(sink, record->text, record->length);
+            }
+            __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+            // head is only stale if the executor is not waiting
+            if (__atomic_load_n(&ring->executor_waiting, __ATOMIC_SEQ_CST) &&
+                __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - (tail + 1) <=
+                    RING_SLOTS - WAKE_BATCH) {
+                __atomic_store_n(&ring->executor_waiting, 0, __ATOMIC_RELAXED);
+                futex_wake(&ring->tail);
+            }
+        }
+    }
+    return NULL;
+}
+
+static void wake_writer(Ring *ring) {
+    __atomic_store_n(&ring->writer_waiting, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ring->signal, 1, __ATOMIC_RELEASE);
+    futex_wake(&ring->signal);
+}
+
+/* Returns the slot for the next record, waiting for the writer to free
+   one if the ring is full */
+static Record *reserve(Ring *ring) {
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail == RING_SLOTS) {
+        ring->stalls++;
+        do {
+            __atomic_store_n(&ring->executor_waiting, 1, __ATOMIC_SEQ_CST);
+            if (head - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == RING_SLOTS) {
+                futex_wait(&ring->tail, tail);
+            }
+            __atomic_store_n(&ring->executor_waiting, 0, __ATOMIC_RELAXED);
+            tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        } while (head - tail == RING_SLOTS);
+    }
+    ring->added++;
+    ring->occupancy += head - tail;
+    if (head - tail > ring->peak) {
+        ring->peak = head - tail;
+    }
+    return &ring->records[head % RING_SLOTS];
+}
+
+/* Hands the reserved record to the writer */
+static void publish(Ring *ring) {
+    uint32_t head = ring->head + 1;
+    __atomic_store_n(&ring->head, head, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->writer_waiting, __ATOMIC_SEQ_CST) &&
+        head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= WAKE_BATCH) {
+        wake_writer(ring);
+    }
+}
+
+static const char *skip_space(const char *at, const char *end) {
+    while (at < end && isspace((unsigned char)*at)) {
+        at++;
+    }
+    return at;
+}
+
+/* Reads the registers of one step as -r prints them, whatever the spacing.
+   Returns where they end, or NULL if the trace has something else there. */
+static const char *take_registers(const char *at, const char *end, Register *R) {
+    for (int i = 0; i < 32; i++) {
+        at = skip_space(at, end);
+        if (at == end || *at++ != 'r') {
+            return NULL;
+        }
+        at = skip_space(at, end);
+        int number = 0;
+        while (at < end && isdigit((unsigned char)*at)) {
+            number = number * 10 + *at++ - '0';
+        }
+        if (number != i || at == end || *at++ != '=') {
+            return NULL;
+        }
+        const char *digits = at;
+        R[i] = 0;
+        while (at < end && isxdigit((unsigned char)*at) && at - digits < 8) {
+            R[i] = R[i] << 4 | (isdigit((unsigned char)*at) ? *at - '0' : (*at | 0x20) - 'a' + 10);
+            at++;
+        }
+        if (at == digits) {
+            return NULL;
+        }
+    }
+    return at;
+}
+
+static void expect_step(Expect *expect, Double index, Register pc, const Register *R) {
+    // almost always the trace is just what the run would have written
+    char formatted[TRACE_TEXT_SIZE];
+    trace_format_registers(formatted, R);
+    if (expect->end - expect->at >= TRACE_TEXT_SIZE &&
+        memcmp(expect->at, formatted, TRACE_TEXT_SIZE) == 0) {
+        expect->at += TRACE_TEXT_SIZE;
+        expect->steps++;
+        return;
+    }
+
+    const char *start = skip_space(expect->at, expect->end);
+    const char *after = take_registers(start, expect->end, expect->want);
+    int differs = after == NULL;
+    for (int i = 0; i < 32 && !differs; i++) {
+        differs = expect->want[i] != R[i];
+    }
+    if (differs) {
+        expect->difference = after == NULL ? NO_STEP : WRONG_REGISTERS;
+        expect->where = start;
+        expect->index = index;
+        expect->pc = pc;
+        memcpy(expect->got, R, sizeof(expect->got));
+        return;
+    }
+    expect->at = skip_space(after, expect->end);
+    expect->steps++;
+}
+
+/* Text matches if it has the same characters other than spaces, as with
+   compare.py */
+static void expect_text(Expect *expect, const char *text, size_t length) {
+    const char *at = expect->at;
+    if ((size_t)(expect->end - at) >= length && memcmp(at, text, length) == 0) {
+        expect->at += length;
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (isspace((unsigned char)text[i])) {
+            continue;
+        }
+        at = skip_space(at, expect->end);
+        if (at == expect->end || *at != text[i]) {
+            // keep the run's line, for the report
+            size_t line = i, stop = i;
+            while (line > 0 && text[line - 1] != '\n') {
+                line--;
+            }
+            while (stop < length && text[stop] != '\n' && stop - line < sizeof(expect->text) - 1) {
+                stop++;
+            }
+            memcpy(expect->text, text + line, stop - line);
+            expect->text[stop - line] = '\0';
+            expect->difference = WRONG_TEXT;
+            expect->where = at;
+            return;
+        }
+        at++;
+    }
+    expect->at = at;
+}
+
+/* Says where the run and the trace part, or how much of it matched */
+static void report(TraceSink *sink) {
+    Expect *expect = sink->expect;
+    const char *line = expect->where;
+    unsigned number = 1;
+    char *out = (char *)sink->buffer;
+    size_t room = BUFFER_SIZE;
+    int length = 0;
+
+    if (expect->difference == MATCHING) {
+        sink->used = snprintf(out, room, "%llu instructions match %s\n",
+                              (unsigned long long)expect->steps, expect->path);
+        return;
+    }
+    for (const char *at = expect->data; at < line; at++) {
+        number += *at == '\n';
+    }
+    while (line > expect->data && line[-1] != '\n') {
+        line--;
+    }
+    const char *eol = memchr(line, '\n', expect->end - line);
+    int width = (eol != NULL ? eol : expect->end) - line;
+
+    switch (expect->difference) {
+    case WRONG_REGISTERS:
+        length = snprintf(out, room, "Instruction %llu at pc %08x does not match %s, line %u:\n",
+                          (unsigned long long)expect->index, expect->pc, expect->path, number);
+        for (int i = 0; i < 32; i++) {
+            if (expect->want[i] != expect->got[i]) {
+                length += snprintf(out + length, room - length, "r%2d: expected %08x, got %08x\n",
+                                   i, expect->want[i], expect->got[i]);
+            }
+        }
+        break;
+    case NO_STEP:
+        if (line == expect->end) {
+            length = snprintf(out, room, "%s ends before instruction %llu at pc %08x\n",
+                              expect->path, (unsigned long long)expect->index, expect->pc);
+        } else {
+            length = snprintf(out, room,
+                              "Instruction %llu at pc %08x is not in %s; line %u has:\n%.*s\n",
+                              (unsigned long long)expect->index, expect->pc, expect->path, number,
+                              width, line);
+        }
+        break;
+    case WRONG_TEXT:
+        length = snprintf(out, room,
+                          "The output after %llu instructions does not match %s, line %u:\n"
+                          "expected: %.*s\ngot: %s\n",
+                          (unsigned long long)expect->steps, expect->path, number, width, line,
+                          expect->text);
+        break;
+    case TRACE_GOES_ON:
+        length = snprintf(out, room, "The run ended after %llu instructions; %s goes on at line %u:\n"
+                          "%.*s\n", (unsigned long long)expect->steps, expect->path, number, width,
+                          line);
+        break;
+    }
+    sink->used = length;
+}
+
+TraceSink *trace_open(int fd, TraceFormat format, int async) {
+    TraceSink *sink = calloc(1, sizeof(TraceSink));
+    if (sink == NULL) {
+        return NULL;
+    }
+    sink->buffer = malloc(BUFFER_SIZE);
+    if (sink->buffer == NULL) {
+        free(sink);
+        return NULL;
+    }
+    sink->fd = fd;
+    sink->format = format;
+    sink->registers = TRACE_ALL_REGISTERS;
+    if (format == TRACE_BINARY) {
+        memcpy(sink->buffer, TRACE_MAGIC, 4);
+        sink->buffer[4] = TRACE_VERSION;
+        sink->used = 5;
+    }
+    if (async) {
+        Ring *ring = calloc(1, sizeof(Ring));
+        if (ring != NULL) {
+            ring->records = malloc(RING_SLOTS * sizeof(Record));
+        }
+        sink->ring = ring;
+        if (ring == NULL || ring->records == NULL ||
+            pthread_create(&ring->writer, NULL, write_records, sink) != 0) {
+            if (ring != NULL) {
+                free(ring->records);
+            }
+            free(ring);
+            free(sink->buffer);
+            free(sink);
+            return NULL;
+        }
+    }
+    return sink;
+}
+
+TraceSink *trace_expect(int fd, const char *path) {
+    struct stat status;
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return NULL;
+    }
+    TraceSink *sink = NULL;
+    Expect *expect = calloc(1, sizeof(Expect));
+    if (fstat(file, &status) == 0 && expect != NULL) {
+        // an empty file cannot be mapped, but then nothing is read from it
+        void *data = status.st_size > 0
+                         ? mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : "";
+        if (data != MAP_FAILED) {
+            expect->data = expect->at = data;
+            expect->end = expect->data + status.st_size;
+            expect->path = strdup(path);
+            sink = trace_open(fd, TRACE_TEXT, 0);
+        }
+        if (sink == NULL || expect->path == NULL) {
+            if (data != MAP_FAILED && status.st_size > 0) {
+                munmap(data, status.st_size);
+            }
+            free(expect->path);
+            if (sink != NULL) {
+                trace_close(sink);
+                sink = NULL;
+            }
+        }
+    }
+    close(file);
+    if (sink == NULL) {
+        free(expect);
+        return NULL;
+    }
+    // the reference is read once, front to back
+    madvise((void *)expect->data, expect->end - expect->data, MADV_SEQUENTIAL);
+    sink->expect = expect;
+    return sink;
+}
+
+void trace_select(TraceSink *sink, Word registers, int numbered) {
+    sink->registers = registers;
+    sink->numbered = numbered;
+}
+
+int trace_diverged(const TraceSink *sink) {
+    return sink->expect != NULL && sink->expect->difference != MATCHING;
+}
+
+void trace_step(TraceSink *sink, Double index, Register pc, const Register *R) {
+    if (sink->expect != NULL) {
+        if (!trace_diverged(sink)) {
+            expect_step(sink->expect, index, pc, R);
+        }
+        return;
+    }
+    if (sink->ring == NULL) {
+        record_step(sink, index, pc, R);
+        return;
+    }
+    Record *record = reserve(sink->ring);
+    record->kind = RECORD_STEP;
+    record->index = index;
+    record->pc = pc;
+    memcpy(record->R, R, sizeof(record->R));
+    publish(sink->ring);
+}
+
+void trace_text(TraceSink *sink, const char *text, size_t length) {
+    // a binary trace has no empty text: that ends its steps
+    if (length == 0) {
+        return;
+    }
+    if (sink->expect != NULL) {
+        if (!trace_diverged(sink)) {
+            expect_text(sink->expect, text, length);
+        }
+        return;
+    }
+    if (sink->ring == NULL) {
+        record_text(sink, length);
+        append(sink, text, length);
+        return;
+    }
+    Word kind = RECORD_TEXT;
+    do {
+        Record *record = reserve(sink->ring);
+        record->kind = kind;
+        record->index = length;
+        record->length = length < sizeof(record->text) ? length : sizeof(record->text);
+        memcpy(record->text, text, record->length);
+        text += record->length;
+        length -= record->length;
+        kind = RECORD_MORE_TEXT;
+        publish(sink->ring);
+    } while (length > 0);
+}
+
+static ssize_t write_text(void *cookie, const char *text, size_t length) {
+    trace_text(cookie, text, length);
+    return length;
+}
+
+FILE *trace_output(TraceSink *sink) {
+    if (sink->stream == NULL) {
+        cookie_io_functions_t functions = {NULL, write_text, NULL, NULL};
+        sink->stream = fopencookie(sink, "w", functions);
+        if (sink->stream != NULL) {
+            setvbuf(sink->stream, NULL, _IONBF, 0);
+        }
+    }
+    return sink->stream;
+}
+
+void trace_stats(const TraceSink *sink, TraceStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (sink->ring != NULL) {
+        stats->records = sink->ring->added;
+        stats->stalls = sink->ring->stalls;
+        stats->slots = RING_SLOTS;
+        stats->peak = sink->ring->peak;
+        stats->mean = stats->records ? (double)sink->ring->occupancy / stats->records : 0;
+    }
+}
+
+int trace_close(TraceSink *sink) {
+    if (sink->stream != NULL) {
+        fclose(sink->stream);
+    }
+    if (sink->ring != NULL) {
+        __atomic_store_n(&sink->ring->closing, 1, __ATOMIC_SEQ_CST);
+        wake_writer(sink->ring);
+        pthread_join(sink->ring->writer, NULL);
+        free(sink->ring->records);
+        free(sink->ring);
+    }
+    if (sink->expect != NULL) {
+        Expect *expect = sink->expect;
+        if (!trace_diverged(sink) && skip_space(expect->at, expect->end) != expect->end) {
+            expect->difference = TRACE_GOES_ON;
+            expect->where = skip_space(expect->at, expect->end);
+        }
+        if (trace_diverged(sink)) {
+            sink->error = 1;
+        }
+        report(sink);
+        if (expect->end > expect->data) {
+            munmap((void *)expect->data, expect->end - expect->data);
+        }
+        free(expect->path);
+        free(expect);
+    }
+    if (sink->format == TRACE_BINARY) {
+        TraceFooter footer = {sink->nchunks, 0, TRACE_INDEX_MAGIC};
+        Byte end = 0;
+        append(sink, &end, 1);
+        footer.offset = sink->written + sink->used;
+        append(sink, sink->chunks, sink->nchunks * sizeof(TraceChunk));
+        append(sink, &footer, sizeof(footer));
+    }
+    flush(sink, NULL, 0);
+    int result = sink->error ? -1 : 0;
+    free(sink->chunks);
+    free(sink->buffer);
+    free(sink);
+    return result;
+}
+
+/* Reads a varint; returns 0, or -1 at the end of the file or a bad one */
+static int get_varint(FILE *in, Double *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(in);
+        if (c == EOF) {
+            return -1;
+        }
+        *value |= (Double)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int trace_decode(FILE *in, FILE *out) {
+    char magic[5];
+    char text[4096];
+    char registers[TRACE_TEXT_SIZE];
+    Register R[32] = {0};
+    Double head, value;
+
+    if (fread(magic, 1, 5, in) != 5 || memcmp(magic, TRACE_MAGIC, 4) != 0 ||
+        (magic[4] != 1 && magic[4] != TRACE_VERSION)) {
+        return -1;
+    }
+    while (get_varint(in, &head) == 0) {
+        if (head == 0 && magic[4] == TRACE_VERSION) {
+            // the index follows
+            return 0;
+        }
+        if (!(head & 1)) {
+            for (Double length = head >> 1; length > 0;) {
+                size_t chunk = length < sizeof(text) ? length : sizeof(text);
+                if (fread(text, 1, chunk, in) != chunk) {
+                    return -1;
+                }
+                fwrite(text, 1, chunk, out);
+                length -= chunk;
+            }
+            continue;
+        }
+        // the index and PC are not part of the text
+        if (get_varint(in, &value) != 0 || get_varint(in, &value) != 0) {
+            return -1;
+        }
+        for (Word changed = head >> 1; changed != 0; changed &= changed - 1) {
+            if (get_varint(in, &value) != 0) {
+                return -1;
+            }
+            R[__builtin_ctz(changed)] += unzigzag(value);
+        }
+        fwrite(registers, 1, trace_format_registers(registers, R), out);
+    }
+    return feof(in) ? 0 : -1;
+}
+
+/* Reads a varint from the bytes at *in, up to end */
+static int take_varint(const Byte **in, const Byte *end, Double *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && *in < end; shift += 7) {
+        Byte c = *(*in)++;
+        *value |= (Double)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int read_chunk(int fd, off_t entries, Double k, TraceChunk *chunk) {
+    off_t at = entries + k * sizeof(TraceChunk);
+    return pread(fd, chunk, sizeof(*chunk), at) == sizeof(*chunk) ? 0 : -1;
+}
+
+int trace_seek(int fd, Double index, Register *pc, Register *R) {
+    struct stat status;
+    TraceFooter footer;
+    TraceChunk chunk;
+
+    if (fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(footer) ||
+        pread(fd, &footer, sizeof(footer), status.st_size - sizeof(footer)) != sizeof(footer) ||
+        memcmp(footer.magic, TRACE_INDEX_MAGIC, 8) != 0 || footer.chunks == 0) {
+        return -1;
+    }
+    // offsets count from the magic, which need not start the file
+    off_t entries = status.st_size - sizeof(footer) - footer.chunks * sizeof(TraceChunk);
+    off_t base = entries - footer.offset;
+    if (entries < 0 || base < 0 || read_chunk(fd, entries, 0, &chunk) != 0 ||
+        index < chunk.first) {
+        return -1;
+    }
+
+    // chunks start at multiples of TRACE_CHUNK, so unless the trace skips
+    // some the first guess holds index; after it, the search bisects
+    Double low = 0, high = footer.chunks;
+    Double k = index / TRACE_CHUNK - chunk.first / TRACE_CHUNK;
+    if (k >= high) {
+        k = high - 1;
+    }
+    while (high - low > 1) {
+        if (k <= low || k >= high) {
+            k = low + (high - low) / 2;
+        }
+        if (read_chunk(fd, entries, k, &chunk) != 0) {
+            return -1;
+        }
+        if (chunk.first <= index) {
+            low = k;
+        } else {
+            high = k;
+        }
+        k = low + (high - low) / 2;
+    }
+
+    // then the chunk's records, up to the next chunk or the end marker
+    TraceChunk after;
+    Double end = footer.offset - 1;
+    if (read_chunk(fd, entries, low, &chunk) != 0 ||
+        (low + 1 < footer.chunks && read_chunk(fd, entries, low + 1, &after) != 0)) {
+        return -1;
+    }
+    if (low + 1 < footer.chunks) {
+        end = after.offset;
+    }
+    if (end < chunk.offset) {
+        return -1;
+    }
+    size_t length = end - chunk.offset;
+    Byte *records = malloc(length);
+    if (records == NULL ||
+        pread(fd, records, length, base + chunk.offset) != (ssize_t)length) {
+        free(records);
+        return -1;
+    }
+
+    const Byte *in = records;
+    Double next = chunk.next, head, value;
+    int result = -1;
+    *pc = chunk.pc;
+    memcpy(R, chunk.R, sizeof(chunk.R));
+    while (result < 0 && take_varint(&in, records + length, &head) == 0) {
+        if (!(head & 1)) {
+            if ((Double)(records + length - in) < head >> 1) {
+                break;
+            }
+            in += head >> 1;
+            continue;
+        }
+        Double at;
+        if (take_varint(&in, records + length, &at) != 0 ||
+            take_varint(&in, records + length, &value) != 0) {
+            break;
+        }
+        at += next;
+        *pc += 4 + unzigzag(value);
+        Word changed = head >> 1;
+        for (; changed != 0; changed &= changed - 1) {
+            if (take_varint(&in, records + length, &value) != 0) {
+                break;
+            }
+            R[__builtin_ctz(changed)] += unzigzag(value);
+        }
+        if (changed != 0 || at > index) {
+            break;
+        }
+        if (at == index) {
+            result = 0;
+        }
+        next = at + 1;
+    }
+    free(records);
+    return result;
+}
+
+int trace_print_step(const char *path, Double index, FILE *out) {
+    int fd = open(path, O_RDONLY);
+    Register pc, R[32];
+    int result = fd >= 0 ? trace_seek(fd, index, &pc, R) : -1;
+    if (result == 0) {
+        char registers[TRACE_TEXT_SIZE];
+        fprintf(out, "pc=%08x\n", pc);
+        fwrite(registers, 1, trace_format_registers(registers, R), out);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    return result;
+}
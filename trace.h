@@ -0,0 +1,126 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "types.h"
+
+/* Writes what -r prints, as text or in binary, into a large buffer that
+   goes out in big write()s. Whatever else the run prints (guest output,
+   the status line) goes through the same buffer, so it stays in order
+   with the registers.
+
+   The text is the eight lines of "r%2d=%08x " that -r has always
+   printed, formatted from a template and a hex table rather than printf.
+
+   The binary form holds, for each retired instruction, its index, its PC
+   and only the registers it changed, so it takes a few bytes per
+   instruction. What else the run prints is kept as text in between, and
+   trace_decode() turns a file back into exactly the text.
+
+   The file starts with the magic "RVTB" and a version byte, 2. Then each
+   record starts with an unsigned LEB128 varint head:
+   - odd: a step. head >> 1 is the mask of the registers that changed.
+     Varints follow with the index less the one after the previous step,
+     the PC less 4 past the previous step's PC (zigzag encoded), and for
+     each register in the mask, in order, the change in its value (zigzag
+     encoded, modulo 2^32). Before the first step, everything is zero.
+   - even: text, head >> 1 bytes of it.
+   - zero: the end of the records. (Version 1 files have no index, and
+     there it is empty text.)
+
+   The steps are in chunks, a new one starting with the first step whose
+   index reaches the next multiple of TRACE_CHUNK. After the end come,
+   in host byte order, an entry for each chunk: the index of its first
+   step and its offset from the magic as 64-bit numbers, then what that
+   step is relative to: the index after the previous step (64-bit), the
+   previous PC and the 32 registers. Last are the number of chunks and
+   the offset of the first entry (64-bit), and the magic "RVTINDEX".
+   trace_seek() uses them to find any step with a few reads. */
+typedef struct TraceSink TraceSink;
+
+typedef enum {
+    TRACE_TEXT,
+    TRACE_BINARY,
+} TraceFormat;
+
+/* Steps in a chunk of a binary trace */
+#define TRACE_CHUNK 16384
+
+/* The length of the text for one instruction's registers */
+#define TRACE_TEXT_SIZE 425
+
+/* Formats the registers as the trace prints them into out, which must
+   hold TRACE_TEXT_SIZE bytes, and returns TRACE_TEXT_SIZE */
+size_t trace_format_registers(char *out, const Register *R);
+
+/* Starts a trace on fd, which it does not own. Returns NULL if out of
+   memory.
+
+   With async set, trace_step() and trace_text() only copy what they are
+   given into a ring, and a writer thread of the sink's own formats it and
+   writes it out. When the writer falls behind and the ring fills up, they
+   wait for it rather than drop anything. */
+TraceSink *trace_open(int fd, TraceFormat, int async);
+
+/* Starts a sink that writes no trace, but compares what a text trace would
+   hold with the one in the file at path, which it maps. Registers and text
+   match if they differ only in spacing, as compare.py has it. Returns NULL
+   if the file cannot be read. */
+TraceSink *trace_expect(int fd, const char *path);
+
+/* Returns whether an expecting sink has come to a difference; nothing
+   after it is compared, so the run can stop */
+int trace_diverged(const TraceSink *);
+
+#define TRACE_ALL_REGISTERS 0xFFFFFFFF
+
+/* Makes the steps record only the registers in the mask; in binary the
+   others stay zero. With numbered set, a text step starts with a line
+   "@INDEX pc=PC", for a trace that leaves steps out. */
+void trace_select(TraceSink *, Word registers, int numbered);
+
+/* Records that the instruction at pc, the index-th to retire, left the
+   registers R */
+void trace_step(TraceSink *, Double index, Register pc, const Register *R);
+
+/* Records text the run printed */
+void trace_text(TraceSink *, const char *text, size_t length);
+
+/* Returns an unbuffered stream whose writes go to trace_text(), for
+   guest output and status lines; it is closed by trace_close() */
+FILE *trace_output(TraceSink *);
+
+typedef struct {
+    Double records;             /* steps and pieces of text put in the ring */
+    Double stalls;              /* times it was full and the run waited */
+    Double slots;               /* records the ring holds; 0 if not async */
+    Double peak;                /* the most records ever waiting */
+    double mean;                /* records waiting when one was put in */
+} TraceStats;
+
+/* Fills in the counters of an asynchronous sink, all zero for another */
+void trace_stats(const TraceSink *, TraceStats *);
+
+/* Writes out the rest of the trace and frees the sink. Returns 0, or -1
+   if anything could not be written. An expecting sink instead writes
+   where the run first differs from its trace, which may be that the trace
+   goes on after the run, or how many instructions matched; it returns -1
+   if they differ. */
+int trace_close(TraceSink *);
+
+/* Writes the text of a binary trace to out. Returns 0, or -1 if in is not
+   a binary trace or ends in the middle of a record. */
+int trace_decode(FILE *in, FILE *out);
+
+/* Sets *pc and R to what the index-th instruction to retire left in the
+   binary trace open on fd, reading only the index and one chunk. Returns
+   0, or -1 if the trace has no index or no such step. */
+int trace_seek(int fd, Double index, Register *pc, Register *R);
+
+/* Prints the PC of the index-th instruction in the binary trace at path,
+   and then the registers it left as -r printed them. Returns 0, or -1 as
+   trace_seek() does or if the file cannot be opened. */
+int trace_print_step(const char *path, Double index, FILE *out);
+
+#endif
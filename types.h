@@ -23,13 +23,40 @@ typedef Word Address; /* unsigned, 32-bit */
 /* A register value */
 typedef Word Register; /* unsigned 32-bit*/
 
+/* Width of each vector register in bits, and in bytes */
+#define VLEN 256
+#define VLENB (VLEN / 8)
+
+/* The vector unit (RVV subset, LMUL=1 only):
+    32 vector registers stored as little-endian element arrays
+    vl and vtype as set by vsetvl{i} */
+typedef struct {
+    Byte v[32][VLENB];
+    Register vl;
+    Register vtype;
+} VectorRegisters;
+
 /* The processor data: 
     32 registers
     LO & HI special registers
-    PC program counter */
+    PC program counter
+    V vector registers
+    instret retired instructions
+    stall cycles spent beyond one per retired instruction
+    status why the last instruction stopped the hart (see emulator.h)
+    fault_address the guest address it could not reach, if that was why
+    reservation & reserved_value the word an lr.w holds, if reserved */
 typedef struct {
     Register R[32];
     Register PC;
+    VectorRegisters V;
+    Double instret;
+    Double stall;
+    int status;
+    Address fault_address;
+    int reserved;
+    Address reservation;
+    Word reserved_value;
 } Processor;
 
 /* Possible lengths of data, and their lengths in bytes.
@@ -103,6 +130,41 @@ typedef union {
 	unsigned int imm7 : 7;
     } sbtype;
 
+
+    /* access atomics with: instruction.atype.(opcode|rd|funct3|rs1|rs2|rl|aq|funct5) */
+    struct {
+	unsigned int opcode : 7;
+	unsigned int rd : 5;
+	unsigned int funct3 : 3;
+	unsigned int rs1 : 5;
+	unsigned int rs2 : 5;
+	unsigned int rl : 1;
+	unsigned int aq : 1;
+	unsigned int funct5 : 5;
+    } atype;
+    /* access vector arithmetic with: instruction.varith.(opcode|vd|funct3|vs1|vs2|vm|funct6) */
+    struct {
+	unsigned int opcode : 7;
+	unsigned int vd : 5;
+	unsigned int funct3 : 3;
+	unsigned int vs1 : 5;
+	unsigned int vs2 : 5;
+	unsigned int vm : 1;
+	unsigned int funct6 : 6;
+    } varith;
+
+    /* access vector loads/stores with: instruction.vmem.(opcode|vd|width|rs1|rs2|vm|mop|mew|nf) */
+    struct {
+	unsigned int opcode : 7;
+	unsigned int vd : 5;
+	unsigned int width : 3;
+	unsigned int rs1 : 5;
+	unsigned int rs2 : 5;
+	unsigned int vm : 1;
+	unsigned int mop : 2;
+	unsigned int mew : 1;
+	unsigned int nf : 3;
+    } vmem;
    
     /* basically ignore this stuff*/
     int16_t chunks16[2];
@@ -26,9 +26,14 @@ Instruction parse_instruction(uint32_t instruction_bits) {
   instruction_bits >>= 7;
 
   switch (instruction.opcode) {
-  // R-Type
+  // R-Type, including the custom opcode spaces
   case 0x33:
   case 0x2a:
+  case 0x0b:
+  case 0x2b:
+  case 0x5b:
+  case 0x7b:
+  case 0x2f:
     // instruction: 0000 0000 0000 0000 0000 destination : 01000
     instruction.rtype.rd = instruction_bits & ((1U << 5) - 1);
     instruction_bits >>= 5;
@@ -53,6 +58,7 @@ Instruction parse_instruction(uint32_t instruction_bits) {
   case 0x3:
   case 0x73:
   case 0x67:
+  case 0x0f:
   
     instruction.itype.rd = instruction_bits & ((1U << 5) - 1);
     instruction_bits >>= 5;
@@ -126,8 +132,57 @@ Instruction parse_instruction(uint32_t instruction_bits) {
     instruction.sbtype.imm7 = instruction_bits & ((1U << 7) - 1);
     break;
 
+  // Vector arithmetic and vsetvl{i} (OP-V)
+  case 0x57:
+    instruction.varith.vd = instruction_bits & ((1U << 5) - 1);
+    instruction_bits >>= 5;
+
+    instruction.varith.funct3 = instruction_bits & ((1U << 3) - 1);
+    instruction_bits >>= 3;
+
+    instruction.varith.vs1 = instruction_bits & ((1U << 5) - 1);
+    instruction_bits >>= 5;
+
+    instruction.varith.vs2 = instruction_bits & ((1U << 5) - 1);
+    instruction_bits >>= 5;
+
+    instruction.varith.vm = instruction_bits & 0x1;
+    instruction_bits >>= 1;
+
+    instruction.varith.funct6 = instruction_bits & ((1U << 6) - 1);
+    break;
+
+  // Vector loads and stores (LOAD-FP / STORE-FP)
+  case 0x07:
+  case 0x27:
+    instruction.vmem.vd = instruction_bits & ((1U << 5) - 1);
+    instruction_bits >>= 5;
+
+    instruction.vmem.width = instruction_bits & ((1U << 3) - 1);
+    instruction_bits >>= 3;
+
+    instruction.vmem.rs1 = instruction_bits & ((1U << 5) - 1);
+    instruction_bits >>= 5;
+
+    instruction.vmem.rs2 = instruction_bits & ((1U << 5) - 1);
+    instruction_bits >>= 5;
+
+    instruction.vmem.vm = instruction_bits & 0x1;
+    instruction_bits >>= 1;
+
+    instruction.vmem.mop = instruction_bits & ((1U << 2) - 1);
+    instruction_bits >>= 2;
+
+    instruction.vmem.mew = instruction_bits & 0x1;
+    instruction_bits >>= 1;
+
+    instruction.vmem.nf = instruction_bits & ((1U << 3) - 1);
+    break;
+
   default:
-    exit(EXIT_FAILURE);
+    // unknown opcode: keep the raw bits for the caller to report
+    instruction.rest = instruction_bits;
+    break;
   }
   return instruction;
 }
@@ -173,12 +228,432 @@ void handle_invalid_instruction(Instruction instruction) {
   printf("Invalid Instruction: 0x%08x\n", instruction.bits);
 }
 
-void handle_invalid_read(Address address) {
-  printf("Bad Read. Address: 0x%08x\n", address);
-  exit(-1);
+/* Inverse of get_branch_offset: scatters a byte offset into the B-type
+ * immediate fields of the given instruction */
+void set_branch_offset(Instruction *instruction, int offset) {
+  instruction->sbtype.imm5 = (offset & 0x1E) | ((offset >> 11) & 0x1);
+  instruction->sbtype.imm7 = ((offset >> 5) & 0x3F) | ((offset >> 6) & 0x40);
+}
+
+/* Inverse of get_jump_offset */
+void set_jump_offset(Instruction *instruction, int offset) {
+  instruction->ujtype.imm = ((offset >> 12) & 0xFF) |
+                            (((offset >> 11) & 0x1) << 8) |
+                            (((offset >> 1) & 0x3FF) << 9) |
+                            (((offset >> 20) & 0x1) << 19);
+}
+
+/* Inverse of get_store_offset */
+void set_store_offset(Instruction *instruction, int offset) {
+  instruction->stype.imm5 = offset & 0x1F;
+  instruction->stype.imm7 = (offset >> 5) & 0x7F;
+}
+
+/* Returns true if the low parcel of the given bits is a 16-bit (RVC)
+ * instruction when the C extension is enabled. Full-size instructions always
+ * have 0b11 in the low bits. The custom lsgt opcode (0x2a) sits in the
+ * compressed encoding space, so programs get one or the other. */
+int is_compressed(uint32_t instruction_bits, int enabled) {
+  return enabled && (instruction_bits & 0x3) != 0x3;
+}
+
+/* Extracts bits hi..lo of a compressed instruction, shifted down to bit 0 */
+static unsigned cbits(Half instruction_bits, unsigned hi, unsigned lo) {
+  return (instruction_bits >> lo) & ((1U << (hi - lo + 1)) - 1);
+}
+
+static uint32_t encode_rtype(unsigned opcode, unsigned rd, unsigned funct3,
+                             unsigned rs1, unsigned rs2, unsigned funct7) {
+  Instruction instruction;
+  instruction.bits = 0;
+  instruction.rtype.opcode = opcode;
+  instruction.rtype.rd = rd;
+  instruction.rtype.funct3 = funct3;
+  instruction.rtype.rs1 = rs1;
+  instruction.rtype.rs2 = rs2;
+  instruction.rtype.funct7 = funct7;
+  return instruction.bits;
+}
+
+static uint32_t encode_itype(unsigned opcode, unsigned rd, unsigned funct3,
+                             unsigned rs1, int imm) {
+  Instruction instruction;
+  instruction.bits = 0;
+  instruction.itype.opcode = opcode;
+  instruction.itype.rd = rd;
+  instruction.itype.funct3 = funct3;
+  instruction.itype.rs1 = rs1;
+  instruction.itype.imm = imm & 0xFFF;
+  return instruction.bits;
+}
+
+static uint32_t encode_stype(unsigned opcode, unsigned funct3, unsigned rs1,
+                             unsigned rs2, int offset) {
+  Instruction instruction;
+  instruction.bits = 0;
+  instruction.stype.opcode = opcode;
+  instruction.stype.funct3 = funct3;
+  instruction.stype.rs1 = rs1;
+  instruction.stype.rs2 = rs2;
+  if (opcode == 0x63) {
+    set_branch_offset(&instruction, offset);
+  } else {
+    set_store_offset(&instruction, offset);
+  }
+  return instruction.bits;
+}
+
+static uint32_t encode_jal(unsigned rd, int offset) {
+  Instruction instruction;
+  instruction.bits = 0;
+  instruction.ujtype.opcode = 0x6F;
+  instruction.ujtype.rd = rd;
+  set_jump_offset(&instruction, offset);
+  return instruction.bits;
+}
+
+/* Expands a 16-bit RVC instruction into its 32-bit RV32I equivalent, so the
+ * rest of the emulator only ever sees full-size encodings. Returns 0 for
+ * reserved encodings and for the floating-point forms we do not implement.
+ * If name is not NULL it receives the compressed mnemonic. */
+uint32_t expand_compressed(Half instruction_bits, const char **name) {
+  const char *mnemonic = NULL;
+  uint32_t expanded = 0;
+  unsigned rd = cbits(instruction_bits, 11, 7);
+  unsigned rs2 = cbits(instruction_bits, 6, 2);
+  unsigned rd_prime = 8 + cbits(instruction_bits, 4, 2);
+  unsigned rs1_prime = 8 + cbits(instruction_bits, 9, 7);
+  unsigned bit12 = cbits(instruction_bits, 12, 12);
+  int imm = sign_extend_number((bit12 << 5) | rs2, 6);
+  int offset;
+
+  // quadrant in the high bits, funct3 in the low bits
+  switch (((instruction_bits & 0x3) << 3) | cbits(instruction_bits, 15, 13)) {
+  // Quadrant 0
+  case 0x00:
+    offset = (cbits(instruction_bits, 12, 11) << 4) |
+             (cbits(instruction_bits, 10, 7) << 6) |
+             (cbits(instruction_bits, 6, 6) << 2) |
+             (cbits(instruction_bits, 5, 5) << 3);
+    if (offset == 0) {
+      break; // includes the all-zero illegal instruction
+    }
+    mnemonic = "c.addi4spn";
+    expanded = encode_itype(0x13, rd_prime, 0x0, 2, offset);
+    break;
+  case 0x02:
+  case 0x06:
+    offset = (cbits(instruction_bits, 12, 10) << 3) |
+             (cbits(instruction_bits, 6, 6) << 2) |
+             (cbits(instruction_bits, 5, 5) << 6);
+    if (cbits(instruction_bits, 15, 13) == 0x2) {
+      mnemonic = "c.lw";
+      expanded = encode_itype(0x03, rd_prime, 0x2, rs1_prime, offset);
+    } else {
+      mnemonic = "c.sw";
+      expanded = encode_stype(0x23, 0x2, rs1_prime, rd_prime, offset);
+    }
+    break;
+
+  // Quadrant 1
+  case 0x08:
+    mnemonic = rd == 0 ? "c.nop" : "c.addi";
+    expanded = encode_itype(0x13, rd, 0x0, rd, imm);
+    break;
+  case 0x09:
+  case 0x0D:
+    offset = (bit12 << 11) | (cbits(instruction_bits, 11, 11) << 4) |
+             (cbits(instruction_bits, 10, 9) << 8) |
+             (cbits(instruction_bits, 8, 8) << 10) |
+             (cbits(instruction_bits, 7, 7) << 6) |
+             (cbits(instruction_bits, 6, 6) << 7) |
+             (cbits(instruction_bits, 5, 3) << 1) |
+             (cbits(instruction_bits, 2, 2) << 5);
+    offset = sign_extend_number(offset, 12);
+    if (cbits(instruction_bits, 15, 13) == 0x1) {
+      mnemonic = "c.jal";
+      expanded = encode_jal(1, offset);
+    } else {
+      mnemonic = "c.j";
+      expanded = encode_jal(0, offset);
+    }
+    break;
+  case 0x0A:
+    mnemonic = "c.li";
+    expanded = encode_itype(0x13, rd, 0x0, 0, imm);
+    break;
+  case 0x0B:
+    if (rd == 2) {
+      offset = (bit12 << 9) | (cbits(instruction_bits, 6, 6) << 4) |
+               (cbits(instruction_bits, 5, 5) << 6) |
+               (cbits(instruction_bits, 4, 3) << 7) |
+               (cbits(instruction_bits, 2, 2) << 5);
+      if (offset == 0) {
+        break;
+      }
+      mnemonic = "c.addi16sp";
+      expanded = encode_itype(0x13, 2, 0x0, 2, sign_extend_number(offset, 10));
+    } else if (imm != 0) {
+      Instruction instruction;
+      instruction.bits = 0;
+      instruction.utype.opcode = 0x37;
+      instruction.utype.rd = rd;
+      instruction.utype.imm = imm & 0xFFFFF;
+      mnemonic = "c.lui";
+      expanded = instruction.bits;
+    }
+    break;
+  case 0x0C:
+    switch (cbits(instruction_bits, 11, 10)) {
+    case 0x0:
+    case 0x1:
+      if (bit12) {
+        break; // shamt[5] is reserved on RV32
+      }
+      if (cbits(instruction_bits, 11, 10) == 0x0) {
+        mnemonic = "c.srli";
+        expanded = encode_itype(0x13, rs1_prime, 0x5, rs1_prime, rs2);
+      } else {
+        mnemonic = "c.srai";
+        expanded = encode_itype(0x13, rs1_prime, 0x5, rs1_prime, 0x400 | rs2);
+      }
+      break;
+    case 0x2:
+      mnemonic = "c.andi";
+      expanded = encode_itype(0x13, rs1_prime, 0x7, rs1_prime, imm);
+      break;
+    case 0x3:
+      if (bit12) {
+        break; // c.subw/c.addw are RV64 only
+      }
+      switch (cbits(instruction_bits, 6, 5)) {
+      case 0x0:
+        mnemonic = "c.sub";
+        expanded = encode_rtype(0x33, rs1_prime, 0x0, rs1_prime, rd_prime, 0x20);
+        break;
+      case 0x1:
+        mnemonic = "c.xor";
+        expanded = encode_rtype(0x33, rs1_prime, 0x4, rs1_prime, rd_prime, 0x0);
+        break;
+      case 0x2:
+        mnemonic = "c.or";
+        expanded = encode_rtype(0x33, rs1_prime, 0x6, rs1_prime, rd_prime, 0x0);
+        break;
+      case 0x3:
+        mnemonic = "c.and";
+        expanded = encode_rtype(0x33, rs1_prime, 0x7, rs1_prime, rd_prime, 0x0);
+        break;
+      }
+      break;
+    }
+    break;
+  case 0x0E:
+  case 0x0F:
+    offset = (bit12 << 8) | (cbits(instruction_bits, 11, 10) << 3) |
+             (cbits(instruction_bits, 6, 5) << 6) |
+             (cbits(instruction_bits, 4, 3) << 1) |
+             (cbits(instruction_bits, 2, 2) << 5);
+    offset = sign_extend_number(offset, 9);
+    if (cbits(instruction_bits, 15, 13) == 0x6) {
+      mnemonic = "c.beqz";
+      expanded = encode_stype(0x63, 0x0, rs1_prime, 0, offset);
+    } else {
+      mnemonic = "c.bnez";
+      expanded = encode_stype(0x63, 0x1, rs1_prime, 0, offset);
+    }
+    break;
+
+  // Quadrant 2
+  case 0x10:
+    if (bit12) {
+      break;
+    }
+    mnemonic = "c.slli";
+    expanded = encode_itype(0x13, rd, 0x1, rd, rs2);
+    break;
+  case 0x12:
+    if (rd == 0) {
+      break;
+    }
+    offset = (bit12 << 5) | (cbits(instruction_bits, 6, 4) << 2) |
+             (cbits(instruction_bits, 3, 2) << 6);
+    mnemonic = "c.lwsp";
+    expanded = encode_itype(0x03, rd, 0x2, 2, offset);
+    break;
+  case 0x14:
+    if (!bit12 && rs2 == 0) {
+      if (rd != 0) {
+        mnemonic = "c.jr";
+        expanded = encode_itype(0x67, 0, 0x0, rd, 0);
+      }
+    } else if (!bit12) {
+      mnemonic = "c.mv";
+      expanded = encode_rtype(0x33, rd, 0x0, 0, rs2, 0x0);
+    } else if (rd == 0 && rs2 == 0) {
+      mnemonic = "c.ebreak";
+      expanded = encode_itype(0x73, 0, 0x0, 0, 1);
+    } else if (rs2 == 0) {
+      mnemonic = "c.jalr";
+      expanded = encode_itype(0x67, 1, 0x0, rd, 0);
+    } else {
+      mnemonic = "c.add";
+      expanded = encode_rtype(0x33, rd, 0x0, rd, rs2, 0x0);
+    }
+    break;
+  case 0x16:
+    offset = (cbits(instruction_bits, 12, 9) << 2) |
+             (cbits(instruction_bits, 8, 7) << 6);
+    mnemonic = "c.swsp";
+    expanded = encode_stype(0x23, 0x2, 2, rs2, offset);
+    break;
+
+  default: // floating-point loads/stores and quadrant 3
+    break;
+  }
+
+  if (name != NULL) {
+    *name = mnemonic;
+  }
+  return expanded;
+}
+
+/* Mnemonics of the supported OP-V arithmetic instructions, indexed by funct6.
+ * OPI forms are .vv/.vx/.vi (funct3 0/4/3), OPM forms .vv/.vx (funct3 2/6).
+ * A NULL entry is an encoding we do not implement. */
+static const char *opi_names[64][3] = {
+    [0x00] = {"vadd.vv", "vadd.vx", "vadd.vi"},
+    [0x02] = {"vsub.vv", "vsub.vx", NULL},
+    [0x03] = {NULL, "vrsub.vx", "vrsub.vi"},
+    [0x04] = {"vminu.vv", "vminu.vx", NULL},
+    [0x05] = {"vmin.vv", "vmin.vx", NULL},
+    [0x06] = {"vmaxu.vv", "vmaxu.vx", NULL},
+    [0x07] = {"vmax.vv", "vmax.vx", NULL},
+    [0x09] = {"vand.vv", "vand.vx", "vand.vi"},
+    [0x0A] = {"vor.vv", "vor.vx", "vor.vi"},
+    [0x0B] = {"vxor.vv", "vxor.vx", "vxor.vi"},
+    [0x17] = {"vmv.v.v", "vmv.v.x", "vmv.v.i"},
+    [0x18] = {"vmseq.vv", "vmseq.vx", "vmseq.vi"},
+    [0x19] = {"vmsne.vv", "vmsne.vx", "vmsne.vi"},
+    [0x1A] = {"vmsltu.vv", "vmsltu.vx", NULL},
+    [0x1B] = {"vmslt.vv", "vmslt.vx", NULL},
+    [0x1C] = {"vmsleu.vv", "vmsleu.vx", "vmsleu.vi"},
+    [0x1D] = {"vmsle.vv", "vmsle.vx", "vmsle.vi"},
+    [0x1E] = {NULL, "vmsgtu.vx", "vmsgtu.vi"},
+    [0x1F] = {NULL, "vmsgt.vx", "vmsgt.vi"},
+};
+
+static const char *opm_names[64][2] = {
+    [0x00] = {"vredsum.vs", NULL},
+    [0x01] = {"vredand.vs", NULL},
+    [0x02] = {"vredor.vs", NULL},
+    [0x03] = {"vredxor.vs", NULL},
+    [0x04] = {"vredminu.vs", NULL},
+    [0x05] = {"vredmin.vs", NULL},
+    [0x06] = {"vredmaxu.vs", NULL},
+    [0x07] = {"vredmax.vs", NULL},
+    [0x10] = {"vmv.x.s", "vmv.s.x"},
+    [0x25] = {"vmul.vv", "vmul.vx"},
+};
+
+/* Returns the mnemonic of an OP-V arithmetic instruction, or NULL if it is
+ * not part of the supported subset */
+const char *get_vector_name(Instruction instruction) {
+  const char *name = NULL;
+  switch (instruction.varith.funct3) {
+  case 0x0:
+    name = opi_names[instruction.varith.funct6][0];
+    break;
+  case 0x4:
+    name = opi_names[instruction.varith.funct6][1];
+    break;
+  case 0x3:
+    name = opi_names[instruction.varith.funct6][2];
+    break;
+  case 0x2:
+    name = opm_names[instruction.varith.funct6][0];
+    break;
+  case 0x6:
+    name = opm_names[instruction.varith.funct6][1];
+    break;
+  }
+
+  // vmv.v.* and the scalar moves are unmasked with a fixed zero operand
+  if (name != NULL && instruction.varith.funct6 == 0x17 &&
+      (!instruction.varith.vm || instruction.varith.vs2 != 0)) {
+    return NULL;
+  }
+  if (name != NULL && instruction.varith.funct6 == 0x10 &&
+      (!instruction.varith.vm ||
+       (instruction.varith.funct3 == 0x2 ? instruction.varith.vs1
+                                         : instruction.varith.vs2) != 0)) {
+    return NULL;
+  }
+  return name;
+}
+
+/* Returns the element width in bytes of a vector load/store, or 0 for the
+ * widths that belong to scalar floating point */
+int get_vector_width(Instruction instruction) {
+  switch (instruction.vmem.width) {
+  case 0x0:
+    return 1;
+  case 0x5:
+    return 2;
+  case 0x6:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+/* Returns the name of a supported CSR, or NULL */
+const char *get_csr_name(int csr) {
+  switch (csr) {
+  case CSR_CYCLE:
+    return "cycle";
+  case CSR_TIME:
+    return "time";
+  case CSR_INSTRET:
+    return "instret";
+  case CSR_CYCLEH:
+    return "cycleh";
+  case CSR_TIMEH:
+    return "timeh";
+  case CSR_INSTRETH:
+    return "instreth";
+  default:
+    return NULL;
+  }
+}
+
+/* Every retired instruction takes one cycle, plus any stalls charged by the
+ * instructions that model slower hardware */
+Double get_cycle_count(const Processor *processor) {
+  return processor->instret + processor->stall;
+}
+
+Double get_time_count(const Processor *processor) {
+  return get_cycle_count(processor) / TIME_DIVISOR;
+}
+
+/* Returns the mnemonic of an RV32A instruction (without its ordering
+ * suffix), or NULL if it is not one */
+const char *get_amo_name(Instruction instruction) {
+  static const char *names[32] = {
+      [0x00] = "amoadd.w", [0x01] = "amoswap.w", [0x02] = "lr.w",
+      [0x03] = "sc.w",     [0x04] = "amoxor.w",  [0x08] = "amoor.w",
+      [0x0C] = "amoand.w", [0x10] = "amomin.w",  [0x14] = "amomax.w",
+      [0x18] = "amominu.w", [0x1C] = "amomaxu.w",
+  };
+  if (instruction.atype.funct3 != 0x2 ||
+      (instruction.atype.funct5 == 0x02 && instruction.atype.rs2 != 0)) {
+    return NULL;
+  }
+  return names[instruction.atype.funct5];
 }
 
-void handle_invalid_write(Address address) {
-  printf("Bad Write. Address: 0x%08x\n", address);
-  exit(-1);
+/* Returns the .aq/.rl suffix of an atomic instruction */
+const char *get_amo_ordering(Instruction instruction) {
+  static const char *suffixes[4] = {"", ".rl", ".aq", ".aqrl"};
+  return suffixes[instruction.atype.aq << 1 | instruction.atype.rl];
 }
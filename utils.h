@@ -5,14 +5,62 @@
 #define MEM_FORMAT "%s\tx%d, %d(x%d)\n"
 #define LUI_FORMAT "lui\tx%d, %d\n"
 #define JAL_FORMAT "jal\tx%d, %d\n"
+#define JALR_FORMAT "jalr\tx%d, %d(x%d)\n"
+#define AUIPC_FORMAT "auipc\tx%d, %d\n"
 #define BRANCH_FORMAT "%s\tx%d, x%d, %d\n"
 #define ECALL_FORMAT "ecall\n"
+#define EBREAK_FORMAT "ebreak\n"
+#define CSR_FORMAT "%s\tx%d, %s, x%d\n"
+#define CSRI_FORMAT "%s\tx%d, %s, %d\n"
+#define AMO_FORMAT "%s%s\tx%d, x%d, (x%d)\n"
+#define LR_FORMAT "lr.w%s\tx%d, (x%d)\n"
+#define FENCE_FORMAT "fence\t%s, %s\n"
+#define FENCE_I_FORMAT "fence.i\n"
+#define CR_FORMAT "%s\tx%d, x%d\n"
+#define CI_FORMAT "%s\tx%d, %d\n"
+#define CJ_FORMAT "%s\t%d\n"
+#define CJR_FORMAT "%s\tx%d\n"
+#define CNOP_FORMAT "c.nop\n"
+#define CEBREAK_FORMAT "c.ebreak\n"
+#define VSETVLI_FORMAT "vsetvli\tx%d, x%d, %s\n"
+#define VSETIVLI_FORMAT "vsetivli\tx%d, %d, %s\n"
+#define VSETVL_FORMAT "vsetvl\tx%d, x%d, x%d\n"
+#define VMEM_FORMAT "%s%d.v\tv%d, (x%d)%s\n"
+#define VMEM_STRIDED_FORMAT "%s%d.v\tv%d, (x%d), x%d%s\n"
+#define VV_FORMAT "%s\tv%d, v%d, v%d%s\n"
+#define VX_FORMAT "%s\tv%d, v%d, x%d%s\n"
+#define VI_FORMAT "%s\tv%d, v%d, %d%s\n"
+#define VMV_V_FORMAT "%s\tv%d, %s%d\n"
+#define VMV_XS_FORMAT "%s\tx%d, v%d\n"
+#define VMV_SX_FORMAT "%s\tv%d, x%d\n"
+
+/* Read-only user counters (Zicntr), readable with the Zicsr instructions */
+#define CSR_CYCLE 0xC00
+#define CSR_TIME 0xC01
+#define CSR_INSTRET 0xC02
+#define CSR_CYCLEH 0xC80
+#define CSR_TIMEH 0xC81
+#define CSR_INSTRETH 0xC82
+
+/* The time CSR ticks once every TIME_DIVISOR cycles, a 10 MHz timer on a
+   100 MHz core, so that it stays deterministic between runs */
+#define TIME_DIVISOR 10
 
 int sign_extend_number(unsigned, unsigned);
 Instruction parse_instruction(uint32_t);
 int get_branch_offset(Instruction);
 int get_jump_offset(Instruction);
 int get_store_offset(Instruction);
+void set_branch_offset(Instruction *, int);
+void set_jump_offset(Instruction *, int);
+void set_store_offset(Instruction *, int);
+int is_compressed(uint32_t, int);
+uint32_t expand_compressed(Half, const char **);
+const char *get_vector_name(Instruction);
+const char *get_csr_name(int);
+const char *get_amo_name(Instruction);
+const char *get_amo_ordering(Instruction);
+Double get_cycle_count(const Processor *);
+Double get_time_count(const Processor *);
+int get_vector_width(Instruction);
 void handle_invalid_instruction(Instruction);
-void handle_invalid_read(Address);
-void handle_invalid_write(Address);
@@ -0,0 +1,451 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+#include "utils.h"
+#include "vector.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HOST_X86 1
+#endif
+
+/* A set of whole-register kernels for one host instruction set */
+typedef struct {
+    const char *name;
+    void (*binary)(VectorOp, unsigned, Byte *, const Byte *, const Byte *);
+    Word (*compare)(VectorCompare, unsigned, const Byte *, const Byte *);
+    Word (*reduce)(VectorOp, unsigned, const Byte *, Word);
+} VectorBackend;
+
+static Word element_mask(unsigned sew) {
+    return sew == 4 ? 0xFFFFFFFF : (1U << (sew * 8)) - 1;
+}
+
+/* All-ones for the VLENB / sew elements of a register */
+static Word register_mask(unsigned sew) {
+    return VLENB / sew == 32 ? 0xFFFFFFFF : (1U << (VLENB / sew)) - 1;
+}
+
+Word vector_get_element(const Byte *reg, unsigned index, unsigned sew) {
+    Word value = 0;
+    for (unsigned i = 0; i < sew; i++) {
+        value |= (Word)reg[index * sew + i] << (8 * i);
+    }
+    return value;
+}
+
+void vector_set_element(Byte *reg, unsigned index, unsigned sew, Word value) {
+    for (unsigned i = 0; i < sew; i++) {
+        reg[index * sew + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+Word vector_scalar_op(VectorOp op, unsigned sew, Word a, Word b) {
+    Word mask = element_mask(sew);
+    sWord sa, sb;
+    Word result = 0;
+
+    a &= mask;
+    b &= mask;
+    sa = sign_extend_number(a, sew * 8);
+    sb = sign_extend_number(b, sew * 8);
+    switch (op) {
+        case VECTOR_ADD:
+            result = a + b;
+            break;
+        case VECTOR_SUB:
+            result = a - b;
+            break;
+        case VECTOR_MUL:
+            result = a * b;
+            break;
+        case VECTOR_MINU:
+            result = a < b ? a : b;
+            break;
+        case VECTOR_MIN:
+            result = sa < sb ? a : b;
+            break;
+        case VECTOR_MAXU:
+            result = a > b ? a : b;
+            break;
+        case VECTOR_MAX:
+            result = sa > sb ? a : b;
+            break;
+        case VECTOR_AND:
+            result = a & b;
+            break;
+        case VECTOR_OR:
+            result = a | b;
+            break;
+        case VECTOR_XOR:
+            result = a ^ b;
+            break;
+    }
+    return result & mask;
+}
+
+Word vector_identity(VectorOp op, unsigned sew) {
+    Word mask = element_mask(sew);
+    switch (op) {
+        case VECTOR_AND:
+        case VECTOR_MINU:
+            return mask;
+        case VECTOR_MIN:
+            return mask >> 1;
+        case VECTOR_MAX:
+            return (mask >> 1) + 1;
+        case VECTOR_MUL:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int scalar_compare(VectorCompare cmp, unsigned sew, Word a, Word b) {
+    sWord sa = sign_extend_number(a, sew * 8);
+    sWord sb = sign_extend_number(b, sew * 8);
+    switch (cmp) {
+        case VECTOR_EQ:
+            return a == b;
+        case VECTOR_NE:
+            return a != b;
+        case VECTOR_LTU:
+            return a < b;
+        case VECTOR_LT:
+            return sa < sb;
+        case VECTOR_LEU:
+            return a <= b;
+        case VECTOR_LE:
+            return sa <= sb;
+        case VECTOR_GTU:
+            return a > b;
+        case VECTOR_GT:
+            return sa > sb;
+    }
+    return 0;
+}
+
+/* Portable fallback, one element at a time */
+
+static void scalar_binary(VectorOp op, unsigned sew, Byte *vd, const Byte *a, const Byte *b) {
+    for (unsigned i = 0; i < VLENB / sew; i++) {
+        vector_set_element(vd, i, sew, vector_scalar_op(op, sew,
+            vector_get_element(a, i, sew), vector_get_element(b, i, sew)));
+    }
+}
+
+static Word scalar_compare_register(VectorCompare cmp, unsigned sew, const Byte *a, const Byte *b) {
+    Word bits = 0;
+    for (unsigned i = 0; i < VLENB / sew; i++) {
+        if (scalar_compare(cmp, sew, vector_get_element(a, i, sew), vector_get_element(b, i, sew))) {
+            bits |= 1U << i;
+        }
+    }
+    return bits;
+}
+
+static Word scalar_reduce(VectorOp op, unsigned sew, const Byte *a, Word init) {
+    for (unsigned i = 0; i < VLENB / sew; i++) {
+        init = vector_scalar_op(op, sew, init, vector_get_element(a, i, sew));
+    }
+    return init;
+}
+
+static const VectorBackend scalar_backend = {
+    "scalar", scalar_binary, scalar_compare_register, scalar_reduce
+};
+
+#ifdef HOST_X86
+
+/* Turns a byte-granular movemask of 16-bit lanes into one bit per lane */
+static Word compress_pairs(Word bits) {
+    Word result = 0;
+    for (unsigned i = 0; i < 16; i++) {
+        result |= ((bits >> (2 * i)) & 1) << i;
+    }
+    return result;
+}
+
+/* SSE4.1: each VLEN register is handled as VLENB / 16 halves */
+
+__attribute__((target("sse4.1")))
+static __m128i sse_mul8(__m128i a, __m128i b) {
+    // no 8-bit multiply: do the even and odd bytes as 16-bit lanes
+    __m128i even = _mm_mullo_epi16(a, b);
+    __m128i odd = _mm_mullo_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    return _mm_or_si128(_mm_slli_epi16(odd, 8), _mm_and_si128(even, _mm_set1_epi16(0xFF)));
+}
+
+__attribute__((target("sse4.1")))
+static __m128i sse_op(VectorOp op, unsigned sew, __m128i a, __m128i b) {
+    switch (op) {
+        case VECTOR_ADD:
+            return sew == 1 ? _mm_add_epi8(a, b) : sew == 2 ? _mm_add_epi16(a, b) : _mm_add_epi32(a, b);
+        case VECTOR_SUB:
+            return sew == 1 ? _mm_sub_epi8(a, b) : sew == 2 ? _mm_sub_epi16(a, b) : _mm_sub_epi32(a, b);
+        case VECTOR_MUL:
+            return sew == 1 ? sse_mul8(a, b) : sew == 2 ? _mm_mullo_epi16(a, b) : _mm_mullo_epi32(a, b);
+        case VECTOR_MINU:
+            return sew == 1 ? _mm_min_epu8(a, b) : sew == 2 ? _mm_min_epu16(a, b) : _mm_min_epu32(a, b);
+        case VECTOR_MIN:
+            return sew == 1 ? _mm_min_epi8(a, b) : sew == 2 ? _mm_min_epi16(a, b) : _mm_min_epi32(a, b);
+        case VECTOR_MAXU:
+            return sew == 1 ? _mm_max_epu8(a, b) : sew == 2 ? _mm_max_epu16(a, b) : _mm_max_epu32(a, b);
+        case VECTOR_MAX:
+            return sew == 1 ? _mm_max_epi8(a, b) : sew == 2 ? _mm_max_epi16(a, b) : _mm_max_epi32(a, b);
+        case VECTOR_AND:
+            return _mm_and_si128(a, b);
+        case VECTOR_OR:
+            return _mm_or_si128(a, b);
+        case VECTOR_XOR:
+            return _mm_xor_si128(a, b);
+    }
+    return a;
+}
+
+__attribute__((target("sse4.1")))
+static __m128i sse_sign_bits(unsigned sew) {
+    return sew == 1 ? _mm_set1_epi8((char)0x80) : sew == 2 ? _mm_set1_epi16((short)0x8000)
+                                                           : _mm_set1_epi32((int)0x80000000);
+}
+
+/* Lane-wise a > b (signed); all-ones where true */
+__attribute__((target("sse4.1")))
+static __m128i sse_gt(unsigned sew, __m128i a, __m128i b) {
+    return sew == 1 ? _mm_cmpgt_epi8(a, b) : sew == 2 ? _mm_cmpgt_epi16(a, b) : _mm_cmpgt_epi32(a, b);
+}
+
+__attribute__((target("sse4.1")))
+static Word sse_compare_half(VectorCompare cmp, unsigned sew, __m128i a, __m128i b) {
+    __m128i result;
+    int invert = 0;
+
+    if (cmp == VECTOR_LTU || cmp == VECTOR_LEU || cmp == VECTOR_GTU) {
+        // unsigned order is signed order with the sign bits flipped
+        a = _mm_xor_si128(a, sse_sign_bits(sew));
+        b = _mm_xor_si128(b, sse_sign_bits(sew));
+    }
+    switch (cmp) {
+        case VECTOR_NE:
+            invert = 1;
+            /* fall through */
+        case VECTOR_EQ:
+            result = sew == 1 ? _mm_cmpeq_epi8(a, b) : sew == 2 ? _mm_cmpeq_epi16(a, b) : _mm_cmpeq_epi32(a, b);
+            break;
+        case VECTOR_LT:
+        case VECTOR_LTU:
+            result = sse_gt(sew, b, a);
+            break;
+        case VECTOR_LE:
+        case VECTOR_LEU:
+            invert = 1;
+            result = sse_gt(sew, a, b);
+            break;
+        default:
+            result = sse_gt(sew, a, b);
+            break;
+    }
+
+    Word bits;
+    if (sew == 4) {
+        bits = _mm_movemask_ps(_mm_castsi128_ps(result));
+    } else if (sew == 2) {
+        bits = compress_pairs(_mm_movemask_epi8(result));
+    } else {
+        bits = _mm_movemask_epi8(result);
+    }
+    return invert ? ~bits & ((1U << (16 / sew)) - 1) : bits;
+}
+
+/* Folds the lanes of one 128-bit value down to lane 0 */
+__attribute__((target("sse4.1")))
+static Word sse_fold(VectorOp op, unsigned sew, __m128i v) {
+    v = sse_op(op, sew, v, _mm_srli_si128(v, 8));
+    v = sse_op(op, sew, v, _mm_srli_si128(v, 4));
+    if (sew <= 2) {
+        v = sse_op(op, sew, v, _mm_srli_si128(v, 2));
+    }
+    if (sew == 1) {
+        v = sse_op(op, sew, v, _mm_srli_si128(v, 1));
+    }
+    return (Word)_mm_cvtsi128_si32(v);
+}
+
+__attribute__((target("sse4.1")))
+static void sse_binary(VectorOp op, unsigned sew, Byte *vd, const Byte *a, const Byte *b) {
+    for (unsigned i = 0; i < VLENB; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(vd + i), sse_op(op, sew, x, y));
+    }
+}
+
+__attribute__((target("sse4.1")))
+static Word sse_compare(VectorCompare cmp, unsigned sew, const Byte *a, const Byte *b) {
+    Word bits = 0;
+    for (unsigned i = 0; i < VLENB; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        bits |= sse_compare_half(cmp, sew, x, y) << (i / sew);
+    }
+    return bits;
+}
+
+__attribute__((target("sse4.1")))
+static Word sse_reduce(VectorOp op, unsigned sew, const Byte *a, Word init) {
+    __m128i v = _mm_loadu_si128((const __m128i *)a);
+    for (unsigned i = 16; i < VLENB; i += 16) {
+        v = sse_op(op, sew, v, _mm_loadu_si128((const __m128i *)(a + i)));
+    }
+    return vector_scalar_op(op, sew, init, sse_fold(op, sew, v));
+}
+
+static const VectorBackend sse_backend = {
+    "sse4.1", sse_binary, sse_compare, sse_reduce
+};
+
+/* AVX2: one 256-bit operation per VLEN register */
+
+__attribute__((target("avx2")))
+static __m256i avx2_mul8(__m256i a, __m256i b) {
+    __m256i even = _mm256_mullo_epi16(a, b);
+    __m256i odd = _mm256_mullo_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+    return _mm256_or_si256(_mm256_slli_epi16(odd, 8), _mm256_and_si256(even, _mm256_set1_epi16(0xFF)));
+}
+
+__attribute__((target("avx2")))
+static __m256i avx2_op(VectorOp op, unsigned sew, __m256i a, __m256i b) {
+    switch (op) {
+        case VECTOR_ADD:
+            return sew == 1 ? _mm256_add_epi8(a, b) : sew == 2 ? _mm256_add_epi16(a, b) : _mm256_add_epi32(a, b);
+        case VECTOR_SUB:
+            return sew == 1 ? _mm256_sub_epi8(a, b) : sew == 2 ? _mm256_sub_epi16(a, b) : _mm256_sub_epi32(a, b);
+        case VECTOR_MUL:
+            return sew == 1 ? avx2_mul8(a, b) : sew == 2 ? _mm256_mullo_epi16(a, b) : _mm256_mullo_epi32(a, b);
+        case VECTOR_MINU:
+            return sew == 1 ? _mm256_min_epu8(a, b) : sew == 2 ? _mm256_min_epu16(a, b) : _mm256_min_epu32(a, b);
+        case VECTOR_MIN:
+            return sew == 1 ? _mm256_min_epi8(a, b) : sew == 2 ? _mm256_min_epi16(a, b) : _mm256_min_epi32(a, b);
+        case VECTOR_MAXU:
+            return sew == 1 ? _mm256_max_epu8(a, b) : sew == 2 ? _mm256_max_epu16(a, b) : _mm256_max_epu32(a, b);
+        case VECTOR_MAX:
+            return sew == 1 ? _mm256_max_epi8(a, b) : sew == 2 ? _mm256_max_epi16(a, b) : _mm256_max_epi32(a, b);
+        case VECTOR_AND:
+            return _mm256_and_si256(a, b);
+        case VECTOR_OR:
+            return _mm256_or_si256(a, b);
+        case VECTOR_XOR:
+            return _mm256_xor_si256(a, b);
+    }
+    return a;
+}
+
+__attribute__((target("avx2")))
+static __m256i avx2_gt(unsigned sew, __m256i a, __m256i b) {
+    return sew == 1 ? _mm256_cmpgt_epi8(a, b) : sew == 2 ? _mm256_cmpgt_epi16(a, b) : _mm256_cmpgt_epi32(a, b);
+}
+
+__attribute__((target("avx2")))
+static void avx2_binary(VectorOp op, unsigned sew, Byte *vd, const Byte *a, const Byte *b) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)a);
+    __m256i y = _mm256_loadu_si256((const __m256i *)b);
+    _mm256_storeu_si256((__m256i *)vd, avx2_op(op, sew, x, y));
+}
+
+__attribute__((target("avx2")))
+static Word avx2_compare(VectorCompare cmp, unsigned sew, const Byte *pa, const Byte *pb) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)pa);
+    __m256i b = _mm256_loadu_si256((const __m256i *)pb);
+    __m256i result;
+    int invert = 0;
+
+    if (cmp == VECTOR_LTU || cmp == VECTOR_LEU || cmp == VECTOR_GTU) {
+        __m256i sign = sew == 1 ? _mm256_set1_epi8((char)0x80) : sew == 2 ? _mm256_set1_epi16((short)0x8000)
+                                                                           : _mm256_set1_epi32((int)0x80000000);
+        a = _mm256_xor_si256(a, sign);
+        b = _mm256_xor_si256(b, sign);
+    }
+    switch (cmp) {
+        case VECTOR_NE:
+            invert = 1;
+            /* fall through */
+        case VECTOR_EQ:
+            result = sew == 1 ? _mm256_cmpeq_epi8(a, b) : sew == 2 ? _mm256_cmpeq_epi16(a, b) : _mm256_cmpeq_epi32(a, b);
+            break;
+        case VECTOR_LT:
+        case VECTOR_LTU:
+            result = avx2_gt(sew, b, a);
+            break;
+        case VECTOR_LE:
+        case VECTOR_LEU:
+            invert = 1;
+            result = avx2_gt(sew, a, b);
+            break;
+        default:
+            result = avx2_gt(sew, a, b);
+            break;
+    }
+
+    Word bits;
+    if (sew == 4) {
+        bits = _mm256_movemask_ps(_mm256_castsi256_ps(result));
+    } else if (sew == 2) {
+        bits = compress_pairs(_mm256_movemask_epi8(result));
+    } else {
+        bits = _mm256_movemask_epi8(result);
+    }
+    return invert ? ~bits & register_mask(sew) : bits;
+}
+
+__attribute__((target("avx2")))
+static Word avx2_reduce(VectorOp op, unsigned sew, const Byte *pa, Word init) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)pa);
+    __m128i v = sse_op(op, sew, _mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+    return vector_scalar_op(op, sew, init, sse_fold(op, sew, v));
+}
+
+static const VectorBackend avx2_backend = {
+    "avx2", avx2_binary, avx2_compare, avx2_reduce
+};
+
+#endif
+
+static const VectorBackend *backend;
+static pthread_once_t backend_once = PTHREAD_ONCE_INIT;
+
+static void select_backend(void) {
+    backend = &scalar_backend;
+#ifdef HOST_X86
+    const char *forced = getenv("RISCV_SIMD");
+    int allow_avx2 = forced == NULL || strcmp(forced, "avx2") == 0;
+    int allow_sse = allow_avx2 || strcmp(forced, "sse4.1") == 0;
+
+    __builtin_cpu_init();
+    if (VLENB == 32 && allow_avx2 && __builtin_cpu_supports("avx2")) {
+        backend = &avx2_backend;
+    } else if (VLENB % 16 == 0 && allow_sse && __builtin_cpu_supports("sse4.1")) {
+        backend = &sse_backend;
+    }
+#endif
+}
+
+void vector_binary(VectorOp op, unsigned sew, Byte *vd, const Byte *a, const Byte *b) {
+    pthread_once(&backend_once, select_backend);
+    backend->binary(op, sew, vd, a, b);
+}
+
+Word vector_compare(VectorCompare cmp, unsigned sew, const Byte *a, const Byte *b) {
+    pthread_once(&backend_once, select_backend);
+    return backend->compare(cmp, sew, a, b);
+}
+
+Word vector_reduce(VectorOp op, unsigned sew, const Byte *a, Word init) {
+    pthread_once(&backend_once, select_backend);
+    return backend->reduce(op, sew, a, init);
+}
+
+const char *vector_backend(void) {
+    pthread_once(&backend_once, select_backend);
+    return backend->name;
+}
@@ -0,0 +1,50 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include "types.h"
+
+/* Element operations done by the host kernels. The values are the OPIVV
+   funct6 encodings of the matching instruction (vmul is OPMVV). */
+typedef enum {
+    VECTOR_ADD = 0x00,
+    VECTOR_SUB = 0x02,
+    VECTOR_MINU = 0x04,
+    VECTOR_MIN = 0x05,
+    VECTOR_MAXU = 0x06,
+    VECTOR_MAX = 0x07,
+    VECTOR_AND = 0x09,
+    VECTOR_OR = 0x0A,
+    VECTOR_XOR = 0x0B,
+    VECTOR_MUL = 0x25,
+} VectorOp;
+
+/* Integer compares, valued as the vmseq..vmsgt funct6 encodings */
+typedef enum {
+    VECTOR_EQ = 0x18,
+    VECTOR_NE = 0x19,
+    VECTOR_LTU = 0x1A,
+    VECTOR_LT = 0x1B,
+    VECTOR_LEU = 0x1C,
+    VECTOR_LE = 0x1D,
+    VECTOR_GTU = 0x1E,
+    VECTOR_GT = 0x1F,
+} VectorCompare;
+
+/* Element access on a little-endian vector register; sew is in bytes */
+Word vector_get_element(const Byte *reg, unsigned index, unsigned sew);
+void vector_set_element(Byte *reg, unsigned index, unsigned sew, Word value);
+
+/* One element of an operation, and the value that leaves a reduction
+   unchanged (used to pad inactive elements) */
+Word vector_scalar_op(VectorOp op, unsigned sew, Word a, Word b);
+Word vector_identity(VectorOp op, unsigned sew);
+
+/* Whole-register kernels over all VLENB bytes. They run on AVX2 or SSE4.1
+   when the host has them, picked on first use; setting RISCV_SIMD to
+   "sse4.1" or "scalar" forces a lower level. */
+void vector_binary(VectorOp op, unsigned sew, Byte *vd, const Byte *a, const Byte *b);
+Word vector_compare(VectorCompare cmp, unsigned sew, const Byte *a, const Byte *b);
+Word vector_reduce(VectorOp op, unsigned sew, const Byte *a, Word init);
+const char *vector_backend(void);
+
+#endif